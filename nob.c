@@ -1,8 +1,8 @@
 #define NOB_IMPLEMENTATION
 #include "nob.h"
 
-const char *srcs[] = {"src/sunburst_draw.c", "src/sunburst.c", "src/sunburst_ui.c", "src/glad.c"};
-const char *objs[] = {"build/sunburst_draw.o", "build/sunburst.o", "build/sunburst_ui.o", "build/glad.o"};
+const char *srcs[] = {"src/sunburst_draw.c", "src/sunburst.c", "src/sunburst_ui.c", "src/sunburst_text.c", "src/sunburst_memory.c", "src/glad.c"};
+const char *objs[] = {"build/sunburst_draw.o", "build/sunburst.o", "build/sunburst_ui.o", "build/sunburst_text.o", "build/sunburst_memory.o", "build/glad.o"};
 
 int unix_sb_lib(){
     Nob_Cmd cmd = {0};
@@ -12,7 +12,7 @@ int unix_sb_lib(){
         if (!nob_cmd_run(&cmd)) return 1;
     }
     cmd.count = 0;
-    nob_cmd_append(&cmd, "libtool", "-static", "-o", "build/sunburst.a", objs[0], objs[1], objs[2]);
+    nob_cmd_append(&cmd, "libtool", "-static", "-o", "build/sunburst.a", objs[0], objs[1], objs[2], objs[3], objs[4]);
     if (!nob_cmd_run(&cmd)) return 1;
     return 0;
 }
@@ -23,13 +23,25 @@ int main(int argc, char **argv) {
 
     Nob_Cmd cmd = {0};
 
+    // `./nob replay` builds the draw capture replay tool and `./nob bench` the
+    // benchmark runner; any other argument is a game source
+    const char *game = argc > 1 ? argv[1] : NULL;
+    const char *exe = "build/game";
+    if (game && strcmp(game, "replay") == 0) {
+        game = "src/replay.c";
+        exe = "build/replay";
+    } else if (game && strcmp(game, "bench") == 0) {
+        game = "src/bench.c";
+        exe = "build/bench";
+    }
+
 #if defined(__APPLE__)
 
     unix_sb_lib();
     
-    if (argc > 1) {
+    if (game) {
         cmd.count = 0;
-        nob_cmd_append(&cmd, "clang", "-c", argv[1], "-o", "build/gameEx.o", "-DGL_SILENCE_DEPRECATION", "-Wno-undefined-inline");
+        nob_cmd_append(&cmd, "clang", "-c", game, "-o", "build/gameEx.o", "-DGL_SILENCE_DEPRECATION", "-Wno-undefined-inline");
         if (!nob_cmd_run(&cmd)) return 1;
 
         cmd.count = 0;
@@ -39,7 +51,7 @@ int main(int argc, char **argv) {
             "-framework", "Cocoa", "-framework", "OpenGL", "-framework", "IOKit",
             "-framework", "CoreVideo",
             "-framework", "QuartzCore",
-            "-o", "build/game"
+            "-o", exe
         );
         if (!nob_cmd_run(&cmd)) return 1;
     } else {
@@ -55,19 +67,19 @@ int main(int argc, char **argv) {
         if (!nob_cmd_run(&cmd)) return 1;
     }
 
-    if (argc > 1) {
+    if (game) {
         cmd.count = 0;
-        nob_cmd_append(&cmd, "cl", "/c", argv[1],
+        nob_cmd_append(&cmd, "cl", "/c", game,
             "/Fo:", "build/gameEx.obj", "/std:c11", "/O2", "/EHsc", "/nologo", "/MD");
         if (!nob_cmd_run(&cmd)) return 1;
 
         cmd.count = 0;
         nob_cmd_append(&cmd,
             "link",
-            "build/glfw3.lib", objs[0], objs[1], objs[2], objs[3],
+            "build/glfw3.lib", objs[0], objs[1], objs[2], objs[3], objs[4], objs[5],
             "build/gameEx.obj",
             "opengl32.lib", "gdi32.lib", "user32.lib", "shell32.lib", "legacy_stdio_definitions.lib",
-            "/OUT:build/game.exe", "/SUBSYSTEM:CONSOLE", "/nologo"
+            nob_temp_sprintf("/OUT:%s.exe", exe), "/SUBSYSTEM:CONSOLE", "/nologo"
         );
         if (!nob_cmd_run(&cmd)) return 1;
     } else {
@@ -78,17 +90,17 @@ int main(int argc, char **argv) {
     
     unix_sb_lib();
 
-     if (argc > 1) {
+     if (game) {
         cmd.count = 0;
-        nob_cmd_append(&cmd, "cc", "-c", argv[1], "-o", "build/gameEx.o", "-DGL_SILENCE_DEPRECATION", "-Wno-undefined-inline");
+        nob_cmd_append(&cmd, "cc", "-c", game, "-o", "build/gameEx.o", "-DGL_SILENCE_DEPRECATION", "-Wno-undefined-inline");
         if (!nob_cmd_run(&cmd)) return 1;
 
         cmd.count = 0;
         nob_cmd_append(&cmd, "cc",
-            "-o", "build/game",
+            "-o", exe,
             "build/gameEx.o",
             "build/sunburst.a", "build/libglfw3.a", 
-            "-lGL", "-lm", "-ldl", "-lpthread", 
+            "-lGL", "-lEGL", "-lm", "-ldl", "-lpthread", 
             "-lX11", "-lXrandr", "-lXi", "-lXxf86vm", 
             "-lXinerama", "-lXcursor"
         );
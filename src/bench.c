@@ -0,0 +1,368 @@
+// Synthetic renderer benchmarks with results written as JSON, so builds can
+// be diffed over time. Built by `./nob bench`.
+//
+//   build/bench [-o results.json] [-f font.ttf] [-n frames]
+//
+// Every workload draws WARMUP_FRAMES unmeasured frames (atlas and glyph cache
+// growth, ring sizing) and then a fixed number of measured ones. Runs
+// headless where SunburstInit supports it, else in a hidden window. The text
+// workload needs a font and is skipped without one.
+#define GLFW_INCLUDE_NONE
+#include "../src/glfw3.h"
+#include "../src/sunburst.h"
+
+#define CLAY_IMPLEMENTATION
+#include "../src/clay.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#define BENCH_W        1280
+#define BENCH_H        720
+#define WARMUP_FRAMES  30
+#define DEFAULT_FRAMES 300
+// FrameStats.gpuMs published by End2D belongs to the frame this many earlier
+#define GPU_LAG 2
+
+static GLFWwindow* s_window = NULL;
+static int s_w = BENCH_W, s_h = BENCH_H;
+
+static bool context_init(void) {
+    if (SunburstInit(SUNBURST_HEADLESS)) return SetHeadlessSize(BENCH_W, BENCH_H);
+
+    if (!SunburstInit(SUNBURST_WINDOWED)) return false;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    s_window = glfwCreateWindow(BENCH_W, BENCH_H, "Bench", NULL, NULL);
+    if (!s_window) return false;
+    glfwMakeContextCurrent(s_window);
+    #if defined(_MSC_VER)
+    if (!gladLoadGL()) {
+        fprintf(stderr, "Failed to load OpenGL via GLAD\n");
+        return false;
+    }
+    #endif
+    glfwSwapInterval(0);
+    return true;
+}
+
+static void set_size(int w, int h) {
+    if (w == s_w && h == s_h) return;
+    s_w = w;
+    s_h = h;
+    if (s_window) glfwSetWindowSize(s_window, w, h);
+    else SetHeadlessSize(w, h);
+}
+
+// Workloads
+// Each draws one whole frame; the index animates the content so nothing can
+// be served from a cache that a real frame wouldn't hit.
+static Color rect_color(int i) {
+    return (Color){ (i % 7) / 6.0f, (i % 11) / 10.0f, (i % 13) / 12.0f, 1.0f };
+}
+
+static void draw_rects(int frame, int count) {
+    ClearBackground();
+    Begin2D(s_w, s_h);
+    const int cols = s_w / 4;
+    for (int i = 0; i < count; ++i) {
+        const int x = (i % cols) * 4 + (frame & 3);
+        const int y = (i / cols * 4 + frame) % s_h;
+        DrawRectangle(x, y, 3, 3, rect_color(i));
+    }
+    End2D();
+}
+
+static void rects_10k(int frame)  { draw_rects(frame, 10000); }
+static void rects_100k(int frame) { draw_rects(frame, 100000); }
+
+static void draw_layout(Clay_RenderCommandArray cmds) {
+    ClearBackground();
+    Begin2D(s_w, s_h);
+    DrawClayCommands(cmds);
+    End2D();
+}
+
+static Clay_Color clay_color(int i) {
+    return (Clay_Color){ (float)(60 + i * 37 % 180), (float)(60 + i * 53 % 180), (float)(60 + i * 71 % 180), 255 };
+}
+
+// Only every 16th level is filled, so layout rather than overdraw dominates
+static void deep_chain(int depth, int seed) {
+    CLAY_AUTO_ID({
+        .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .padding = CLAY_PADDING_ALL(1) },
+        .backgroundColor = depth % 16 ? (Clay_Color){0} : clay_color(seed + depth)
+    }) {
+        if (depth > 0) deep_chain(depth - 1, seed);
+    }
+}
+
+// 8 columns, each a chain of 256 nested elements
+static void clay_deep(int frame) {
+    Clay_SetLayoutDimensions((Clay_Dimensions){ (float)s_w, (float)s_h });
+    Clay_BeginLayout();
+    CLAY(CLAY_ID("DeepRoot"), {
+        .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .childGap = (uint16_t)(frame & 3) }
+    }) {
+        for (int c = 0; c < 8; ++c) deep_chain(255, c * 31);
+    }
+    draw_layout(Clay_EndLayout());
+}
+
+// rows x cols cells of fixed-size rounded rectangles
+static void wide_grid(int frame, int rows, int cols) {
+    CLAY_AUTO_ID({
+        .layout = { .layoutDirection = CLAY_TOP_TO_BOTTOM, .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .childGap = 2 }
+    }) {
+        for (int r = 0; r < rows; ++r) {
+            CLAY_AUTO_ID({ .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .childGap = 2 } }) {
+                for (int c = 0; c < cols; ++c) {
+                    CLAY_AUTO_ID({
+                        .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) } },
+                        .backgroundColor = clay_color(r * cols + c + frame),
+                        .cornerRadius = CLAY_CORNER_RADIUS(2)
+                    }) {}
+                }
+            }
+        }
+    }
+}
+
+// 80 rows of 80 cells
+static void clay_wide(int frame) {
+    Clay_SetLayoutDimensions((Clay_Dimensions){ (float)s_w, (float)s_h });
+    Clay_BeginLayout();
+    CLAY(CLAY_ID("WideRoot"), {
+        .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .padding = CLAY_PADDING_ALL(4) }
+    }) {
+        wide_grid(frame, 80, 80);
+    }
+    draw_layout(Clay_EndLayout());
+}
+
+static const char s_lorem[] =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut "
+    "labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris "
+    "nisi ut aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in voluptate velit "
+    "esse cillum dolore eu fugiat nulla pariatur. Excepteur sint occaecat cupidatat non proident, sunt "
+    "in culpa qui officia deserunt mollit anim id est laborum.";
+
+// 4 columns of 40 word-wrapped paragraphs in mixed sizes
+static void text_heavy(int frame) {
+    Clay_SetLayoutDimensions((Clay_Dimensions){ (float)s_w, (float)s_h });
+    Clay_BeginLayout();
+    CLAY(CLAY_ID("TextRoot"), {
+        .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .padding = CLAY_PADDING_ALL(8), .childGap = 8 }
+    }) {
+        for (int c = 0; c < 4; ++c) {
+            CLAY_AUTO_ID({
+                .layout = { .layoutDirection = CLAY_TOP_TO_BOTTOM, .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .childGap = 4 },
+                .backgroundColor = { 245, 242, 238, 255 },
+                .clip = { .vertical = true, .childOffset = { 0, (float)-(frame % 200) } }
+            }) {
+                for (int p = 0; p < 40; ++p) {
+                    // Slices of the paragraph so the lines differ
+                    const int start = (p * 29 + c * 7) % 120;
+                    const Clay_String text = { .isStaticallyAllocated = true,
+                        .length = (int32_t)(sizeof s_lorem - 1 - start), .chars = s_lorem + start };
+                    CLAY_TEXT(text, CLAY_TEXT_CONFIG({ .fontSize = (uint16_t)(12 + p % 4 * 2),
+                                                       .textColor = clay_color(p) }));
+                }
+            }
+        }
+    }
+    draw_layout(Clay_EndLayout());
+}
+
+// The framebuffer and layout change size every frame
+static void resize_storm(int frame) {
+    set_size(640 + frame * 37 % (BENCH_W - 639), 360 + frame * 23 % (BENCH_H - 359));
+    Clay_SetLayoutDimensions((Clay_Dimensions){ (float)s_w, (float)s_h });
+    Clay_BeginLayout();
+    CLAY(CLAY_ID("ResizeRoot"), {
+        .layout = { .sizing = { CLAY_SIZING_GROW(0), CLAY_SIZING_GROW(0) }, .padding = CLAY_PADDING_ALL(8), .childGap = 8 }
+    }) {
+        CLAY(CLAY_ID("ResizeSidebar"), {
+            .layout = { .sizing = { CLAY_SIZING_PERCENT(0.25f), CLAY_SIZING_GROW(0) } },
+            .backgroundColor = { 224, 215, 210, 255 }
+        }) {}
+        wide_grid(frame, 20, 20);
+    }
+    draw_layout(Clay_EndLayout());
+}
+
+typedef struct Workload {
+    const char* name;
+    void (*frame)(int frame);
+    bool needsFont;
+} Workload;
+
+static const Workload s_workloads[] = {
+    { "rects_10k",    rects_10k,    false },
+    { "rects_100k",   rects_100k,   false },
+    { "clay_deep",    clay_deep,    false },
+    { "clay_wide",    clay_wide,    false },
+    { "text_heavy",   text_heavy,   true  },
+    { "resize_storm", resize_storm, false },
+};
+
+// Results
+typedef struct Summary { double mean, p50, p99, max; } Summary;
+
+static int cmp_double(const void* a, const void* b) {
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentiles, as GetFrameTimeStats; sorts v
+static Summary summarize(double* v, int n) {
+    Summary s = {0};
+    if (n <= 0) return s;
+    qsort(v, (size_t)n, sizeof *v, cmp_double);
+    for (int i = 0; i < n; ++i) s.mean += v[i];
+    s.mean /= n;
+    s.p50 = v[(int)ceil(0.50 * n) - 1];
+    s.p99 = v[(int)ceil(0.99 * n) - 1];
+    s.max = v[n - 1];
+    return s;
+}
+
+static void write_summary(FILE* f, const char* key, Summary s) {
+    fprintf(f, "      \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+            key, s.mean, s.p50, s.p99, s.max);
+}
+
+static void write_json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; s && *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if ((unsigned char)*s >= 0x20) fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// Runs one workload and appends its JSON object to f
+static bool run_workload(FILE* f, const Workload* w, int frames, bool first) {
+    double* wallMs = (double*)calloc((size_t)frames, sizeof *wallMs);
+    double* cpuMs  = (double*)calloc((size_t)frames, sizeof *cpuMs);
+    double* gpuMs  = (double*)calloc((size_t)frames, sizeof *gpuMs);
+    if (!wallMs || !cpuMs || !gpuMs) {
+        fprintf(stderr, "Out of memory.\n");
+        free(wallMs); free(cpuMs); free(gpuMs);
+        return false;
+    }
+
+    set_size(BENCH_W, BENCH_H);
+    for (int i = 0; i < WARMUP_FRAMES; ++i) {
+        w->frame(i);
+        if (s_window) glfwSwapBuffers(s_window);
+    }
+
+    ResetMemPeaks();
+    const MemStats before = GetMemTotals(false);
+
+    // GPU_LAG trailing frames read back the last measured frames' GPU times
+    FrameStats last = {0};
+    MemStats after = {0};
+    for (int i = 0; i < frames + GPU_LAG; ++i) {
+        const double start = GetTime();
+        w->frame(WARMUP_FRAMES + i);
+        const double end = GetTime();
+        if (s_window) glfwSwapBuffers(s_window);
+
+        const FrameStats st = GetFrameStats();
+        if (i < frames) {
+            wallMs[i] = (end - start) * 1e3;
+            cpuMs[i] = st.cpuMs;
+            last = st;
+        }
+        if (i >= GPU_LAG) gpuMs[i - GPU_LAG] = st.gpuMs;
+        if (i == frames - 1) after = GetMemTotals(false);
+    }
+    const MemStats gpu = GetMemTotals(true);
+
+    const Summary wall = summarize(wallMs, frames);
+    const Summary cpu = summarize(cpuMs, frames);
+    const Summary gpuSum = summarize(gpuMs, frames);
+    free(wallMs); free(cpuMs); free(gpuMs);
+
+    fprintf(f, "%s    {\n      \"name\": \"%s\",\n      \"frames\": %d,\n", first ? "" : ",\n", w->name, frames);
+    write_summary(f, "frame_ms", wall);
+    write_summary(f, "renderer_cpu_ms", cpu);
+    write_summary(f, "gpu_ms", gpuSum);
+    fprintf(f, "      \"quads\": %u,\n      \"draw_calls\": %u,\n", last.quads, last.drawCalls);
+    fprintf(f, "      \"allocs_per_frame\": %.3f,\n", (double)(after.allocs - before.allocs) / frames);
+    fprintf(f, "      \"cpu_bytes\": %zu,\n      \"peak_cpu_bytes\": %zu,\n      \"gpu_bytes\": %zu\n    }",
+            after.liveBytes, after.peakBytes, gpu.liveBytes);
+
+    fprintf(stderr, "%-14s frame %.3f ms (p99 %.3f), renderer cpu %.3f ms (p99 %.3f), gpu %.3f ms (p99 %.3f)\n",
+            w->name, wall.mean, wall.p99, cpu.mean, cpu.p99, gpuSum.mean, gpuSum.p99);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* outPath = "bench.json";
+    const char* fontPath = NULL;
+    int frames = DEFAULT_FRAMES;
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 < argc && strcmp(argv[i], "-o") == 0) outPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-f") == 0) fontPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) frames = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [-o results.json] [-f font.ttf] [-n frames]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (frames < 1) frames = 1;
+
+    if (!context_init()) {
+        fprintf(stderr, "Failed to create a GL context.\n");
+        SunburstShutdown();
+        return EXIT_FAILURE;
+    }
+    RendererInit();
+
+    Clay_SetMaxElementCount(16384);
+    const uint64_t bytes = Clay_MinMemorySize();
+    void* mem = PersistentAlloc(MEM_UI, bytes);
+    if (!mem) {
+        fprintf(stderr, "Out of memory.\n");
+        return EXIT_FAILURE;
+    }
+    Clay_Initialize(Clay_CreateArenaWithCapacityAndMemory(bytes, mem),
+                    (Clay_Dimensions){ BENCH_W, BENCH_H }, (Clay_ErrorHandler){ HandleClayErrors, NULL });
+    Clay_SetMeasureTextFunction(MeasureClayText, NULL);
+    const bool haveFont = fontPath && LoadFont(0, fontPath);
+
+    FILE* f = fopen(outPath, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s for writing.\n", outPath);
+        return EXIT_FAILURE;
+    }
+    fprintf(f, "{\n  \"gl_renderer\": ");
+    write_json_string(f, (const char*)glGetString(GL_RENDERER));
+    fprintf(f, ",\n  \"mode\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"warmup_frames\": %d,\n  \"workloads\": [\n",
+            s_window ? "window" : "headless", BENCH_W, BENCH_H, WARMUP_FRAMES);
+
+    bool first = true, ok = true;
+    for (size_t i = 0; i < sizeof s_workloads / sizeof s_workloads[0] && ok; ++i) {
+        const Workload* w = &s_workloads[i];
+        if (w->needsFont && !haveFont) {
+            fprintf(stderr, "%-14s skipped (pass -f font.ttf)\n", w->name);
+            continue;
+        }
+        ok = run_workload(f, w, frames, first);
+        first = false;
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    if (ok) fprintf(stderr, "Wrote %s\n", outPath);
+
+    RendererShutdown();
+    if (s_window) glfwDestroyWindow(s_window);
+    SunburstShutdown();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -14,13 +14,33 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+    // F9 toggles recording the drawn frames for build/replay
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        if (IsCapturing()) EndCapture();
+        else if (BeginCapture("capture.sbc")) InvalidateClayFrame(); // record the current frame too
+    }
+
+    // F10 toggles a zone trace for chrome://tracing or ui.perfetto.dev
+    if (key == GLFW_KEY_F10 && action == GLFW_PRESS) {
+        if (g_profilerEnabled) EndProfiling();
+        else BeginProfiling("trace.json");
+    }
 }
 
+// Contents were damaged (expose, restore); redraw even if the layout is unchanged
+static void refresh_callback(GLFWwindow* window)
+{
+    (void)window;
+    InvalidateClayFrame();
+}
 
-int main(void)
+
+int main(int argc, char** argv)
 {
     
-    SunburstInit();
+    if (!SunburstInit(SUNBURST_WINDOWED))
+        exit(EXIT_FAILURE);
 
     GLFWwindow* window = glfwCreateWindow(640, 480, "Editor", NULL, NULL);
     if (!window)
@@ -29,6 +49,7 @@ int main(void)
         exit(EXIT_FAILURE);
     }
     glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
     glfwMakeContextCurrent(window);
 
     #if defined(_MSC_VER)
@@ -43,11 +64,17 @@ int main(void)
     glfwSwapInterval(1);
 
     RendererInit();
+    SetOpaqueDepthPass(true); // nested opaque Clay backgrounds
+    SetDynamicResolution(true, 8.0, 0.5); // drop to half resolution before missing 8 ms
+    SetClayTextNative(true);
 
     uint64_t bytes = Clay_MinMemorySize();
-    void* mem = malloc(bytes);
+    void* mem = PersistentAlloc(MEM_UI, bytes); // lives as long as the engine
     Clay_Arena arena = Clay_CreateArenaWithCapacityAndMemory(bytes, mem);
     Clay_Initialize(arena, (Clay_Dimensions){ 640, 480 }, (Clay_ErrorHandler){ HandleClayErrors });
+    Clay_SetMeasureTextFunction(MeasureClayText, NULL);
+    if (argc > 1) LoadFont(0, argv[1]); // a .ttf for fontId 0
+    SetClayElementCached(CLAY_ID("Caption"), true); // drawn as one quad once it holds still
 
     int size = 75;
     double xpos, ypos;
@@ -64,6 +91,7 @@ while (!glfwWindowShouldClose(window)){
     double mouse_y_px = ypos * yscale;
 
     Clay_SetLayoutDimensions((Clay_Dimensions){ width * xscale, height * yscale });
+    PROFILE_BEGIN("layout");
     Clay_BeginLayout();
 
         // Outer container
@@ -112,43 +140,52 @@ while (!glfwWindowShouldClose(window)){
             CLAY(
                 CLAY_ID("MainContent"),
                 (Clay_ElementDeclaration){
-                    .layout = { .sizing = { .width = CLAY_SIZING_GROW(0), .height = CLAY_SIZING_GROW(0) } },
+                    .layout = {
+                        .sizing = { .width = CLAY_SIZING_GROW(0), .height = CLAY_SIZING_GROW(0) },
+                        .padding = CLAY_PADDING_ALL(16)
+                    },
                     .backgroundColor = (Clay_Color){250,230,250,255}
                 }
-            ) { }
+            ) {
+                // Fixed size, so resizing the panel only moves it and the
+                // cache keeps compositing the same texture
+                CLAY(CLAY_ID("Caption"), (Clay_ElementDeclaration){
+                    .layout = {
+                        .sizing = { .width = CLAY_SIZING_FIXED(320), .height = CLAY_SIZING_FIXED(96) },
+                        .padding = CLAY_PADDING_ALL(16)
+                    },
+                    .backgroundColor = (Clay_Color){235,205,240,255},
+                    .cornerRadius = CLAY_CORNER_RADIUS(8)
+                }) {
+                    CLAY_TEXT(CLAY_STRING("Drag with the left mouse button to resize the panel."),
+                              CLAY_TEXT_CONFIG({ .fontSize = 20, .textColor = (Clay_Color){60,40,70,255} }));
+                }
+            }
         }
 
         Clay_RenderCommandArray cmds = Clay_EndLayout();
+        PROFILE_END();
 
-        ClearBackground();
-        Begin2D(width * xscale, height * yscale);
-
-        for (int i = 0; i < cmds.length; i++) {
-            Clay_RenderCommand* rc = &cmds.internalArray[i];
-            switch (rc->commandType) {
-                case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
-                    Color c = {
-                        rc->renderData.rectangle.backgroundColor.r / 255.0f,
-                        rc->renderData.rectangle.backgroundColor.g / 255.0f,
-                        rc->renderData.rectangle.backgroundColor.b / 255.0f,
-                        rc->renderData.rectangle.backgroundColor.a / 255.0f
-                    };
-                    DrawRectangle(rc->boundingBox.x, rc->boundingBox.y,
-                                  rc->boundingBox.width, rc->boundingBox.height, c);
-                } break;
-                default:
-                    break;
-            }
-        }
+        if (ClayFrameChanged(cmds, width * xscale, height * yscale)) {
+            ClearBackground();
+            Begin2D(width * xscale, height * yscale);
 
-        End2D();
+            DrawClayCommands(cmds);
+
+            End2D();
+            PROFILE_BEGIN("swap");
+            glfwSwapBuffers(window);
+            PROFILE_END();
+        }
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    // Nothing animates, so sleep until input; an unchanged layout then costs
+    // one Clay pass and no GPU work
+    glfwWaitEvents();
 }
 
+    EndProfiling();
     glfwDestroyWindow(window);
 
-    glfwTerminate();
+    SunburstShutdown(); // terminates GLFW and frees the engine arenas
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+// Plays a draw capture (BeginCapture) back as fast as possible and prints
+// each frame's CPU and GPU time, for A/B-testing renderer changes on a fixed
+// workload. Built by `./nob replay`.
+//
+//   build/replay capture.sbc [loops]
+//
+// Runs headless where SunburstInit supports it, else in a hidden window.
+#define GLFW_INCLUDE_NONE
+#include "../src/glfw3.h"
+#include "../src/sunburst.h"
+
+#define CLAY_IMPLEMENTATION
+#include "../src/clay.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// FrameStats.gpuMs published by End2D belongs to the frame this many earlier
+#define GPU_LAG 2
+
+static GLFWwindow* s_window = NULL;
+
+static bool context_init(int width, int height) {
+    if (SunburstInit(SUNBURST_HEADLESS)) return SetHeadlessSize(width, height);
+
+    if (!SunburstInit(SUNBURST_WINDOWED)) return false;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    s_window = glfwCreateWindow(width, height, "Replay", NULL, NULL);
+    if (!s_window) return false;
+    glfwMakeContextCurrent(s_window);
+    #if defined(_MSC_VER)
+    if (!gladLoadGL()) {
+        fprintf(stderr, "Failed to load OpenGL via GLAD\n");
+        return false;
+    }
+    #endif
+    glfwSwapInterval(0);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.sbc [loops]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const int loops = argc > 2 ? atoi(argv[2]) : 1;
+
+    CaptureReplay* capture = LoadCapture(argv[1]);
+    if (!capture) return EXIT_FAILURE;
+    const CaptureInfo info = GetCaptureInfo(capture);
+    if (info.frames == 0 || info.width <= 0 || info.height <= 0) {
+        fprintf(stderr, "%s holds no frames.\n", argv[1]);
+        UnloadCapture(capture);
+        return EXIT_FAILURE;
+    }
+    if (!context_init(info.width, info.height)) {
+        fprintf(stderr, "Failed to create a GL context.\n");
+        UnloadCapture(capture);
+        SunburstShutdown();
+        return EXIT_FAILURE;
+    }
+    RendererInit();
+
+    const int total = info.frames * (loops > 0 ? loops : 1);
+    double* cpuMs = (double*)calloc((size_t)total, sizeof *cpuMs);
+    double* gpuMs = (double*)calloc((size_t)total, sizeof *gpuMs);
+    if (!cpuMs || !gpuMs) {
+        fprintf(stderr, "Out of memory.\n");
+        free(cpuMs);
+        free(gpuMs);
+        UnloadCapture(capture);
+        RendererShutdown();
+        if (s_window) glfwDestroyWindow(s_window);
+        SunburstShutdown();
+        return EXIT_FAILURE;
+    }
+
+    // GPU_LAG trailing empty frames read back the last real frames' GPU times
+    const double start = GetTime();
+    for (int i = 0; i < total + GPU_LAG; ++i) {
+        ClearBackground();
+        if (i < total) {
+            if (i % info.frames == 0) RewindCapture(capture);
+            ReplayCaptureFrame(capture);
+        } else {
+            Begin2D(info.width, info.height);
+            End2D();
+        }
+        if (s_window) glfwSwapBuffers(s_window);
+
+        const FrameStats st = GetFrameStats();
+        if (i < total) cpuMs[i] = st.cpuMs;
+        if (i >= GPU_LAG) gpuMs[i - GPU_LAG] = st.gpuMs;
+    }
+    const double wallMs = (GetTime() - start) * 1e3;
+
+    double cpuSum = 0.0, gpuSum = 0.0, cpuMax = 0.0, gpuMax = 0.0;
+    printf("frame,cpu_ms,gpu_ms\n");
+    for (int i = 0; i < total; ++i) {
+        printf("%d,%.4f,%.4f\n", i, cpuMs[i], gpuMs[i]);
+        cpuSum += cpuMs[i];
+        gpuSum += gpuMs[i];
+        if (cpuMs[i] > cpuMax) cpuMax = cpuMs[i];
+        if (gpuMs[i] > gpuMax) gpuMax = gpuMs[i];
+    }
+    fprintf(stderr, "%d frames (%dx%d) in %.1f ms: cpu avg %.3f max %.3f ms, gpu avg %.3f max %.3f ms\n",
+            total, info.width, info.height, wallMs, cpuSum / total, cpuMax, gpuSum / total, gpuMax);
+
+    free(cpuMs);
+    free(gpuMs);
+    UnloadCapture(capture);
+    RendererShutdown();
+    if (s_window) glfwDestroyWindow(s_window);
+    SunburstShutdown();
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,13 @@
 #include "sunburst.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__linux__)
+  #include <EGL/egl.h>
+  #include <EGL/eglext.h>
+#endif
 
 #if defined(_WIN32)
   #include <windows.h>
@@ -26,28 +34,362 @@
   }
 #endif
 
+double GetTime(void) {
+    return now_seconds();
+}
+
+// Frame timing
+// MarkFrame stores the interval since its previous call in a ring of the last
+// FRAME_HISTORY frames. Queries copy the requested window into a scratch array
+// and sort it there, so recording never allocates and stays O(1).
+#define FRAME_HISTORY 1024
+
+typedef struct FrameTimes {
+    double last;                 // now_seconds of the previous MarkFrame; 0 before the first
+    float ms[FRAME_HISTORY];
+    int head;                    // next slot to write
+    int count;                   // valid samples, up to FRAME_HISTORY
+    double deadlineMs;           // vsync interval; 0 = not counting misses
+    float sorted[FRAME_HISTORY]; // query scratch
+} FrameTimes;
+
+static FrameTimes s_frames = {0};
+
+void MarkFrame(void) {
+    const double now = now_seconds();
+    if (s_frames.last != 0.0) {
+        s_frames.ms[s_frames.head] = (float)((now - s_frames.last) * 1e3);
+        s_frames.head = (s_frames.head + 1) % FRAME_HISTORY;
+        if (s_frames.count < FRAME_HISTORY) s_frames.count++;
+    }
+    s_frames.last = now;
+}
+
+void SetFrameDeadline(double ms) {
+    s_frames.deadlineMs = ms > 0.0 ? ms : 0.0;
+}
+
+void ResetFrameTimeStats(void) {
+    s_frames.count = 0;
+    s_frames.head = 0;
+    s_frames.last = 0.0;
+}
+
+static int compare_float(const void* a, const void* b) {
+    const float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of n sorted samples
+static double percentile(const float* sorted, int n, double p) {
+    int i = (int)ceil(p * n) - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+FrameTimeStats GetFrameTimeStats(int frames) {
+    FrameTimeStats st = {0};
+    const int n = frames <= 0 || frames > s_frames.count ? s_frames.count : frames;
+    if (n == 0) return st;
+
+    // The newest n samples, oldest first
+    const int start = (s_frames.head - n + FRAME_HISTORY) % FRAME_HISTORY;
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const float ms = s_frames.ms[(start + i) % FRAME_HISTORY];
+        s_frames.sorted[i] = ms;
+        sum += ms;
+        // A frame spanning k vsync intervals skipped k - 1 of them
+        if (s_frames.deadlineMs > 0.0) {
+            const int intervals = (int)(ms / s_frames.deadlineMs + 0.5);
+            if (intervals > 1) st.missedDeadlines += intervals - 1;
+        }
+    }
+    st.frames = n;
+    st.meanMs = sum / n;
+    double var = 0.0;
+    for (int i = 0; i < n; ++i) {
+        const double d = s_frames.sorted[i] - st.meanMs;
+        var += d * d;
+    }
+    st.varianceMs2 = var / n;
+
+    qsort(s_frames.sorted, (size_t)n, sizeof s_frames.sorted[0], compare_float);
+    st.minMs = s_frames.sorted[0];
+    st.maxMs = s_frames.sorted[n - 1];
+    st.p50Ms = percentile(s_frames.sorted, n, 0.50);
+    st.p95Ms = percentile(s_frames.sorted, n, 0.95);
+    st.p99Ms = percentile(s_frames.sorted, n, 0.99);
+    return st;
+}
 
 void PrintFrameRate(void) {
     static double prevTime = 0.0;
     static int frames = 0;
 
-    double current = now_seconds();
+    MarkFrame();
+    const double current = s_frames.last;
     if (prevTime == 0.0)
         prevTime = current;
-
     frames++;
 
-    double elapsed = current - prevTime;
-    if (elapsed >= 1.0) {
-        double fps = (double)frames / elapsed;
-        printf("FPS: %.1f\n", fps);
+    if (current - prevTime >= 1.0) {
+        const FrameTimeStats st = GetFrameTimeStats(frames);
+        printf("FPS: %.1f  ms min %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f  sd %.2f  missed %d\n",
+               (double)frames / (current - prevTime), st.minMs, st.p50Ms, st.p95Ms, st.p99Ms, st.maxMs,
+               sqrt(st.varianceMs2), st.missedDeadlines);
         frames = 0;
         prevTime = current;
     }
 }
 
+// Zone profiler
+// Each thread gets a slot on its first zone: a stack of open zones and a
+// single-producer ring of completed ones. The thread only ever advances the
+// ring's head and the dumper only its tail, so recording takes no lock; a
+// full ring drops the zone and counts it. The dumper thread drains every
+// ring each PROFILE_DUMP_MS into the trace file as Chrome "X" events.
+// Zones are stamped with the cheapest raw counter the platform has (the TSC
+// on x86) and the dumper converts ticks to time against now_seconds.
+#define PROFILE_MAX_THREADS 32
+#define PROFILE_MAX_DEPTH   64
+#define PROFILE_RING_EVENTS 16384 // power of two
+#define PROFILE_DUMP_MS     10
+
+#if defined(_MSC_VER)
+  #define PROFILE_TLS __declspec(thread)
+  // x86/x64 volatile accesses are acquire/release under MSVC's default /volatile:ms
+  #define profile_load_acquire(p)     (*(volatile const unsigned int*)(p))
+  #define profile_store_release(p, v) (*(volatile unsigned int*)(p) = (v))
+  #define profile_fetch_add(p)        ((unsigned int)InterlockedIncrement((volatile LONG*)(p)) - 1)
+#else
+  #include <pthread.h>
+  #define PROFILE_TLS _Thread_local
+  #define profile_load_acquire(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+  #define profile_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+  #define profile_fetch_add(p)        __atomic_fetch_add((p), 1u, __ATOMIC_ACQ_REL)
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #include <intrin.h>
+  static inline unsigned long long profile_ticks(void) { return __rdtsc(); }
+#elif defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  static inline unsigned long long profile_ticks(void) { return __rdtsc(); }
+#elif defined(_WIN32)
+  static inline unsigned long long profile_ticks(void) {
+      LARGE_INTEGER t; QueryPerformanceCounter(&t);
+      return (unsigned long long)t.QuadPart;
+  }
+#elif defined(__APPLE__)
+  static inline unsigned long long profile_ticks(void) { return mach_absolute_time(); }
+#else
+  static inline unsigned long long profile_ticks(void) {
+      struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+  }
+#endif
+
+typedef struct ProfileEvent {
+    const char* name;
+    unsigned long long start, end; // profile_ticks
+} ProfileEvent;
+
+typedef struct ProfileThread {
+    unsigned int head;       // written by the owning thread
+    unsigned int tail;       // written by the dumper
+    unsigned int ready;      // slot published to the dumper
+    unsigned int dropped;
+    unsigned int generation; // BeginProfiling run the open stack belongs to
+    int depth;
+    const char* names[PROFILE_MAX_DEPTH];
+    unsigned long long starts[PROFILE_MAX_DEPTH];
+    ProfileEvent* events;    // PROFILE_RING_EVENTS
+} ProfileThread;
+
+typedef struct Profiler {
+    ProfileThread threads[PROFILE_MAX_THREADS];
+    unsigned int threadCount; // slots handed out, possibly past PROFILE_MAX_THREADS
+    unsigned int generation;
+    unsigned int quit;
+    FILE* file;
+    unsigned long long origin; // trace time zero, in ticks
+    double originSeconds;      // now_seconds at origin
+    double ticksPerUs;         // measured by the dumper against now_seconds
+    bool firstEvent;
+#if defined(_WIN32)
+    HANDLE dumper;
+#else
+    pthread_t dumper;
+#endif
+} Profiler;
+
+bool g_profilerEnabled = false;
+static Profiler s_prof = {0};
+static PROFILE_TLS ProfileThread* s_profThread = NULL;
+static PROFILE_TLS bool s_profNoSlot = false;
+
+static ProfileThread* profile_register(void) {
+    if (s_profNoSlot) return NULL;
+    const unsigned int i = profile_fetch_add(&s_prof.threadCount);
+    ProfileEvent* events = i < PROFILE_MAX_THREADS
+        ? (ProfileEvent*)MemAlloc(MEM_DEBUG, PROFILE_RING_EVENTS * sizeof(ProfileEvent)) : NULL;
+    if (!events) {
+        s_profNoSlot = true; // out of slots or memory: this thread goes unprofiled
+        return NULL;
+    }
+    ProfileThread* t = &s_prof.threads[i];
+    t->events = events;
+    profile_store_release(&t->ready, 1u);
+    s_profThread = t;
+    return t;
+}
+
+void ProfileBegin(const char* name) {
+    ProfileThread* t = s_profThread ? s_profThread : profile_register();
+    if (!t) return;
+    if (t->generation != s_prof.generation) {
+        t->generation = s_prof.generation; // zones left open by an earlier run
+        t->depth = 0;
+    }
+    if (t->depth < PROFILE_MAX_DEPTH) {
+        t->names[t->depth] = name;
+        t->starts[t->depth] = profile_ticks();
+    }
+    t->depth++;
+}
+
+void ProfileEnd(void) {
+    ProfileThread* t = s_profThread;
+    if (!t || t->depth == 0 || t->generation != s_prof.generation) return;
+    const unsigned long long end = profile_ticks();
+    const int d = --t->depth;
+    if (d >= PROFILE_MAX_DEPTH) return;
+
+    const unsigned int head = t->head;
+    if (head - profile_load_acquire(&t->tail) == PROFILE_RING_EVENTS) {
+        t->dropped++;
+        return;
+    }
+    t->events[head & (PROFILE_RING_EVENTS - 1)] = (ProfileEvent){ t->names[d], t->starts[d], end };
+    profile_store_release(&t->head, head + 1);
+}
+
+static void profile_write_name(FILE* f, const char* s) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if ((unsigned char)*s >= 0x20) fputc(*s, f);
+    }
+}
+
+static void profile_drain(void) {
+    // Ticks per microsecond over the run so far, which settles within a
+    // few drains
+    const unsigned long long ticks = profile_ticks();
+    const double us = (now_seconds() - s_prof.originSeconds) * 1e6;
+    if (us > 0.0 && ticks > s_prof.origin) s_prof.ticksPerUs = (double)(ticks - s_prof.origin) / us;
+    if (s_prof.ticksPerUs <= 0.0) return; // no rate yet: the rings wait for the next drain
+
+    unsigned int count = profile_load_acquire(&s_prof.threadCount);
+    if (count > PROFILE_MAX_THREADS) count = PROFILE_MAX_THREADS;
+    for (unsigned int i = 0; i < count; ++i) {
+        ProfileThread* t = &s_prof.threads[i];
+        if (!profile_load_acquire(&t->ready)) continue;
+        const unsigned int head = profile_load_acquire(&t->head);
+        unsigned int tail = t->tail;
+        for (; tail != head; ++tail) {
+            const ProfileEvent* e = &t->events[tail & (PROFILE_RING_EVENTS - 1)];
+            if (e->start < s_prof.origin) continue; // finished as an earlier run stopped
+            fputs(s_prof.firstEvent ? "\n" : ",\n", s_prof.file);
+            s_prof.firstEvent = false;
+            fputs("{\"name\":\"", s_prof.file);
+            profile_write_name(s_prof.file, e->name);
+            fprintf(s_prof.file, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    (double)(e->start - s_prof.origin) / s_prof.ticksPerUs,
+                    (double)(e->end - e->start) / s_prof.ticksPerUs, i + 1);
+        }
+        profile_store_release(&t->tail, tail);
+    }
+}
+
+static void profile_dumper(void) {
+    while (!profile_load_acquire(&s_prof.quit)) {
+#if defined(_WIN32)
+        Sleep(PROFILE_DUMP_MS);
+#else
+        const struct timespec nap = { 0, PROFILE_DUMP_MS * 1000000L };
+        nanosleep(&nap, NULL);
+#endif
+        profile_drain();
+    }
+    profile_drain();
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI profile_dumper_main(LPVOID arg) { (void)arg; profile_dumper(); return 0; }
+#else
+static void* profile_dumper_main(void* arg) { (void)arg; profile_dumper(); return NULL; }
+#endif
+
+bool BeginProfiling(const char* path) {
+    EndProfiling();
+    s_prof.file = fopen(path, "wb");
+    if (!s_prof.file) {
+        fprintf(stderr, "Failed to open profile trace %s.\n", path);
+        return false;
+    }
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", s_prof.file);
+    s_prof.firstEvent = true;
+    s_prof.originSeconds = now_seconds();
+    s_prof.origin = profile_ticks();
+    s_prof.ticksPerUs = 0.0;
+    s_prof.quit = 0;
+#if defined(_WIN32)
+    s_prof.dumper = CreateThread(NULL, 0, profile_dumper_main, NULL, 0, NULL);
+    const bool started = s_prof.dumper != NULL;
+#else
+    const bool started = pthread_create(&s_prof.dumper, NULL, profile_dumper_main, NULL) == 0;
+#endif
+    if (!started) {
+        fprintf(stderr, "Failed to start the profile dumper thread.\n");
+        fclose(s_prof.file);
+        s_prof.file = NULL;
+        return false;
+    }
+    s_prof.generation++;
+    g_profilerEnabled = true;
+    return true;
+}
+
+void EndProfiling(void) {
+    if (!s_prof.file) return;
+    g_profilerEnabled = false;
+    profile_store_release(&s_prof.quit, 1u);
+#if defined(_WIN32)
+    WaitForSingleObject(s_prof.dumper, INFINITE);
+    CloseHandle(s_prof.dumper);
+#else
+    pthread_join(s_prof.dumper, NULL);
+#endif
+    unsigned int dropped = 0;
+    for (int i = 0; i < PROFILE_MAX_THREADS; ++i) {
+        dropped += s_prof.threads[i].dropped;
+        s_prof.threads[i].dropped = 0;
+    }
+    if (dropped) fprintf(stderr, "Profiler dropped %u zones; the trace has gaps.\n", dropped);
+    fputs("\n]}\n", s_prof.file);
+    fclose(s_prof.file);
+    s_prof.file = NULL;
+}
+
 void ClearBackground(void) {
-    glClearColor(0.08f, 0.08f, 0.10f, 1.0f);
+    const Color bg = { 0.08f, 0.08f, 0.10f, 1.0f };
+    if (GetRenderBackend() == RENDER_BACKEND_SOFTWARE) {
+        ClearSoftwareTarget(bg);
+        return;
+    }
+    glClearColor(bg.r, bg.g, bg.b, bg.a);
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
@@ -64,10 +406,184 @@ void error_callback(int error, const char* description)
     fprintf(stderr, "Error: %s\n", description);
 }
 
-void SunburstInit(){
+// Headless: a surfaceless EGL context (no window system, runs on llvmpipe)
+// drawing into an offscreen FBO with color and depth renderbuffers.
+typedef struct Headless {
+#if defined(__linux__)
+    EGLDisplay display;
+    EGLContext context;
+#endif
+    GLuint fbo, color, depth;
+    int width, height;
+} Headless;
+
+static SunburstMode s_mode = SUNBURST_WINDOWED;
+static Headless s_headless = {0};
+
+static bool headless_init(void) {
+#if defined(__linux__)
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    if (getPlatformDisplay) dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (dpy == EGL_NO_DISPLAY) dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major = 0, minor = 0;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+        fprintf(stderr, "Headless: no EGL display (0x%x).\n", eglGetError());
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "Headless: EGL has no desktop OpenGL (0x%x).\n", eglGetError());
+        eglTerminate(dpy);
+        return false;
+    }
+
+    const EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    // No config and no surface: rendering only ever goes to our FBO
+    EGLContext ctx = eglCreateContext(dpy, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (ctx == EGL_NO_CONTEXT || !eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        fprintf(stderr, "Headless: could not create a surfaceless GL 3.3 context (0x%x).\n", eglGetError());
+        if (ctx != EGL_NO_CONTEXT) eglDestroyContext(dpy, ctx);
+        eglTerminate(dpy);
+        return false;
+    }
+
+    s_headless.display = dpy;
+    s_headless.context = ctx;
+    return true;
+#else
+    fprintf(stderr, "Headless mode needs EGL and is only available on Linux.\n");
+    return false;
+#endif
+}
+
+bool SunburstInit(SunburstMode mode) {
+    s_mode = mode;
+    if (mode == SUNBURST_HEADLESS) return headless_init();
+
     glfwSetErrorCallback(error_callback);
-    glfwInit();
+    if (!glfwInit()) return false;
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    return true;
+}
+
+void SunburstShutdown(void) {
+    ReleaseEngineArenas();
+    if (s_mode == SUNBURST_WINDOWED) {
+        glfwTerminate();
+        return;
+    }
+#if defined(__linux__)
+    if (!s_headless.context) return;
+    if (s_headless.fbo)   glDeleteFramebuffers(1, &s_headless.fbo);
+    if (s_headless.color) glDeleteRenderbuffers(1, &s_headless.color);
+    if (s_headless.depth) glDeleteRenderbuffers(1, &s_headless.depth);
+    MemTrackGpu(MEM_GPU_TEXTURES, -8ll * s_headless.width * s_headless.height);
+    eglMakeCurrent(s_headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(s_headless.display, s_headless.context);
+    eglTerminate(s_headless.display);
+#endif
+    memset(&s_headless, 0, sizeof s_headless);
+}
+
+bool SetHeadlessSize(int width, int height) {
+    if (s_mode != SUNBURST_HEADLESS || width <= 0 || height <= 0) return false;
+    if (width == s_headless.width && height == s_headless.height) {
+        glBindFramebuffer(GL_FRAMEBUFFER, s_headless.fbo);
+        return true;
+    }
+
+    if (!s_headless.fbo) {
+        glGenFramebuffers(1, &s_headless.fbo);
+        glGenRenderbuffers(1, &s_headless.color);
+        glGenRenderbuffers(1, &s_headless.depth);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, s_headless.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, s_headless.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // Color plus depth, which drivers pad to 4 bytes
+    MemTrackGpu(MEM_GPU_TEXTURES, 8ll * width * height - 8ll * s_headless.width * s_headless.height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, s_headless.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, s_headless.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, s_headless.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Headless: offscreen framebuffer %dx%d incomplete.\n", width, height);
+        MemTrackGpu(MEM_GPU_TEXTURES, -8ll * width * height);
+        s_headless.width = s_headless.height = 0;
+        return false;
+    }
+    s_headless.width = width;
+    s_headless.height = height;
+    return true;
+}
+
+// Height of the framebuffer bound for reading: the window's, or that of an
+// FBO's color attachment. The viewport can't stand in for it, as dynamic
+// resolution and render targets leave it covering only part.
+static GLint read_framebuffer_height(void) {
+    GLint fbo = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fbo);
+    if (fbo == 0) {
+        int w = 0, h = 0;
+        GLFWwindow* window = glfwGetCurrentContext();
+        if (window) glfwGetFramebufferSize(window, &w, &h);
+        return h;
+    }
+    if ((GLuint)fbo == s_headless.fbo) return s_headless.height;
+
+    GLint type = GL_NONE, name = 0, level = 0, h = 0;
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                          GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+    glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                          GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &name);
+    if (type == GL_RENDERBUFFER) {
+        GLint prev = 0;
+        glGetIntegerv(GL_RENDERBUFFER_BINDING, &prev);
+        glBindRenderbuffer(GL_RENDERBUFFER, (GLuint)name);
+        glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &h);
+        glBindRenderbuffer(GL_RENDERBUFFER, (GLuint)prev);
+    } else if (type == GL_TEXTURE) {
+        // A 2D texture, or else a layer of an array texture
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                              GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL, &level);
+        GLint prev2D = 0, prevArray = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &prev2D);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &prevArray);
+        while (glGetError() != GL_NO_ERROR) {}
+        glBindTexture(GL_TEXTURE_2D, (GLuint)name);
+        if (glGetError() == GL_NO_ERROR) {
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &h);
+        } else {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)name);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, level, GL_TEXTURE_HEIGHT, &h);
+        }
+        glBindTexture(GL_TEXTURE_2D, (GLuint)prev2D);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)prevArray);
+    }
+    return h;
+}
+
+void ReadFramebufferPixels(int x, int y, int width, int height, unsigned char* rgba) {
+    const GLint fbH = read_framebuffer_height();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x, fbH - y - height, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+    // GL rows run bottom-up; hand them back top-down like everything else here
+    const size_t stride = (size_t)width * 4;
+    for (int r = 0; r < height / 2; ++r) {
+        unsigned char* a = rgba + (size_t)r * stride;
+        unsigned char* b = rgba + (size_t)(height - 1 - r) * stride;
+        for (size_t i = 0; i < stride; ++i) { unsigned char t = a[i]; a[i] = b[i]; b[i] = t; }
+    }
 }
\ No newline at end of file
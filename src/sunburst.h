@@ -1,5 +1,9 @@
 #pragma once
 #include <stdbool.h>
+#if defined(__linux__)
+  // GL 3.x entry points come from glext.h; glfw3.h may pull in GL/gl.h first
+  #define GL_GLEXT_PROTOTYPES 1
+#endif
 #include "clay.h"
 #include "glfw3.h"
 #if defined(__APPLE__)
@@ -15,20 +19,321 @@
 typedef struct Color { float r, g, b, a; } Color;
 
 // Diagnostics
-void PrintFrameRate(void);
+double GetTime(void); // seconds on a monotonic clock
+
+// Frame-time statistics over the newest `frames` frames (0 or more than are
+// recorded = all of the last 1024). Call MarkFrame once per presented frame,
+// e.g. after swapping buffers; it only stores a timestamp delta. With a
+// deadline set (the vsync interval), missedDeadlines counts the intervals
+// that passed without a new frame, so one 50 ms hitch at 60 Hz counts 2.
+typedef struct FrameTimeStats {
+    int frames;
+    double minMs, meanMs, p50Ms, p95Ms, p99Ms, maxMs;
+    double varianceMs2;  // of frame time, ms^2
+    int missedDeadlines;
+} FrameTimeStats;
+
+void MarkFrame(void);
+void SetFrameDeadline(double ms); // e.g. 1000.0 / 60; 0 = don't count
+FrameTimeStats GetFrameTimeStats(int frames);
+void ResetFrameTimeStats(void);
+void PrintFrameRate(void); // MarkFrame, then once a second prints that second's stats
+
+// Zone profiler. PROFILE_BEGIN(name) / PROFILE_END() bracket a zone on the
+// calling thread; zones nest, and name must outlive the trace (a literal).
+// Between BeginProfiling and EndProfiling each thread records finished zones
+// into its own lock-free ring and a background thread streams them to path
+// as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev). Otherwise a
+// zone costs one predictable branch; define SUNBURST_NO_PROFILER to compile
+// zones out entirely.
+bool BeginProfiling(const char* path); // truncates path
+void EndProfiling(void);                // flushes and closes the trace
+void ProfileBegin(const char* name);
+void ProfileEnd(void);
+extern bool g_profilerEnabled;
+
+#if defined(SUNBURST_NO_PROFILER)
+  #define PROFILE_BEGIN(name) ((void)0)
+  #define PROFILE_END()       ((void)0)
+#else
+  #define PROFILE_BEGIN(name) do { if (g_profilerEnabled) ProfileBegin(name); } while (0)
+  #define PROFILE_END()       do { if (g_profilerEnabled) ProfileEnd(); } while (0)
+#endif
+
+// Tracking allocator. Engine allocations go through MemAlloc & co. under the
+// subsystem's tag, which counts live bytes, peaks and allocation counts per
+// tag. The GPU tags hold estimates of buffer and texture storage, reported by
+// the renderer through MemTrackGpu. A tag's budget (0 = unlimited) makes
+// allocations that would exceed it fail as if the heap were exhausted; for
+// the GPU tags it stops the sprite atlas growing and is otherwise advisory.
+// Thread-safe; MemFree and MemRealloc must get MemAlloc'd pointers.
+typedef enum MemTag {
+    MEM_GENERAL,      // untagged, and the application's own
+    MEM_RENDERER,     // batch staging, draw queue, clip table, software raster buffers
+    MEM_TEXTURES,     // image table, decoded images, CPU pixel copies, pending uploads
+    MEM_TEXT,         // font files and the glyph cache
+    MEM_UI,           // the Clay arena (PersistentAlloc(MEM_UI, ...))
+    MEM_FRAME,        // frame arena blocks
+    MEM_DEBUG,        // capture buffers and profiler rings
+    MEM_GPU_BUFFERS,  // estimated: vertex, index, pixel and texture buffers
+    MEM_GPU_TEXTURES, // estimated: the sprite atlas and renderbuffers
+    MEM_TAG_COUNT
+} MemTag;
+
+typedef struct MemStats {
+    size_t liveBytes, peakBytes;
+    unsigned long long allocs, frees; // GPU tags: storage grown / shrunk or released
+    unsigned long long failed;        // refused by the budget or the heap
+    size_t budget;
+} MemStats;
+
+void* MemAlloc(MemTag, size_t bytes);
+void* MemCalloc(MemTag, size_t count, size_t size);
+void* MemRealloc(MemTag, void* p, size_t bytes); // keeps p's tag; MemAlloc when p is NULL
+void MemFree(void* p);
+bool MemTrackGpu(MemTag, long long deltaBytes); // false (and untracked) past the budget
+void SetMemBudget(MemTag, size_t bytes);
+MemStats GetMemStats(MemTag);
+MemStats GetMemTotals(bool gpu); // CPU or GPU tags summed; peakBytes is the sum of peaks
+void ResetMemPeaks(void);        // peaks restart from the live bytes
+const char* GetMemTagName(MemTag);
+
+// Arenas: bump allocators over a chain of blocks, zero-initialised = empty.
+// ArenaAlloc returns memory aligned to at least 16 (align 0 = 16) and NULL
+// only when the heap is exhausted. ArenaReset keeps the memory, merging the
+// chain into one block, so a reset-and-refill loop settles into no heap
+// traffic at all. Blocks are charged to the arena's tag. Not thread-safe.
+typedef struct ArenaBlock ArenaBlock;
+typedef struct Arena { ArenaBlock* block; size_t capacity, used; MemTag tag; } Arena;
+
+void* ArenaAlloc(Arena*, size_t bytes, size_t align);
+void ArenaReset(Arena*);
+void ArenaRelease(Arena*); // frees every block
+
+// Engine arenas (main thread). FrameAlloc memory stays valid through the
+// current frame and the next: End2D calls AdvanceFrameArena, which recycles
+// the allocations made two frames back. PersistentAlloc memory, from one
+// arena per tag, lives until SunburstShutdown, which releases them all.
+void* FrameAlloc(size_t bytes);
+void AdvanceFrameArena(void);
+void* PersistentAlloc(MemTag, size_t bytes);
+void ReleaseEngineArenas(void);
+
+// Vertex streaming counters, cumulative since init or the last reset.
+// Non-zero fenceWaits or regrows mean the ring is too small for the workload.
+typedef struct StreamRingStats {
+    unsigned long long bytesStreamed; // bytes copied into the ring
+    unsigned long long fenceWaits;    // writes that blocked on the GPU finishing a region
+    unsigned long long regrows;       // single uploads larger than a region (ring reallocated)
+    size_t ringBytes;                 // current ring size across all regions
+} StreamRingStats;
+
+StreamRingStats GetStreamRingStats(void);
+void ResetStreamRingStats(void);
+
+// Per-frame renderer cost, published by End2D. cpuMs covers Begin2D..End2D;
+// cpuMs - emitMs is time spent recording draws (e.g. DrawClayCommands), emitMs
+// is sorting and replaying the queue, and flushMs the part of that spent
+// streaming batches and issuing draw calls. gpuMs is the GPU time of those
+// draw calls, read back a few frames late so it never stalls the pipeline.
+typedef struct FrameStats {
+    unsigned int quads;               // rects and sprites drawn
+    unsigned int drawCalls;           // batch flushes
+    unsigned long long bytesUploaded; // bytes streamed into the vertex rings
+    double cpuMs;
+    double emitMs;
+    double flushMs;
+    double gpuMs;
+    unsigned int glCallsIssued;       // state changes that reached GL
+    unsigned int glCallsSkipped;      // redundant ones the state cache dropped
+} FrameStats;
+
+FrameStats GetFrameStats(void);
+
+// The renderer shadows the GL state it sets and skips redundant calls. Call
+// this after changing GL state yourself (binds, blend, viewport, ...) so the
+// next frame re-issues everything.
+void ResetGLStateCache(void);
 
 // simple 2D drawing
+typedef enum RectBatchMode {
+    RECT_BATCH_INDEXED,   // 4 vertices per rect + shared index buffer
+    RECT_BATCH_INSTANCED  // 1 instance record per rect over a static unit quad (default)
+} RectBatchMode;
+
+typedef struct CornerRadii { int topLeft, topRight, bottomLeft, bottomRight; } CornerRadii;
+typedef struct BorderWidths { int left, right, top, bottom; } BorderWidths;
+
 void DrawRectangle(int, int, int, int, Color);
+// Rounded corners and borders are drawn with a distance field on a single
+// quad. Radii are clamped to half the shorter side, radii and widths to 255.
+void DrawRectangleRounded(int x, int y, int w, int h, CornerRadii radius, Color c);
+void DrawRectangleBorder(int x, int y, int w, int h, BorderWidths widths, CornerRadii radius, Color c);
+void SetRectBatchMode(RectBatchMode);
+
+// Bulk flat rects from parallel arrays, packed into the batch in one pass
+// (SIMD where available) for particle and heatmap style views. Draws queued
+// before the call are emitted first and the rects draw on top of them in
+// array order, regardless of SetDrawLayer. Honors the current clip rect.
+void DrawRectangles(const int* x, const int* y, const int* w, const int* h, const Color* colors, size_t count);
+
+// Draws opaque flat rects front to back into the depth buffer before the
+// blended draws, so hidden background pixels are rejected before shading.
+// Needs a depth buffer and the instanced rect path; off by default.
+void SetOpaqueDepthPass(bool enabled);
+
+// Textures are packed into layers of one shared texture array, so sprites
+// from different images batch together. They live until UnloadTexture or
+// RendererShutdown; unloading gives the space back for later loads and lets
+// the id be reused, so drop the handle with it.
+typedef struct Texture { unsigned int id; int width, height; } Texture; // id 0 = invalid
+
+Texture LoadTexture(const char* path);
+Texture LoadTextureFromPixels(const unsigned char* rgba, int width, int height);
+void UnloadTexture(Texture t); // draws already made this frame still show it
+
+// Async variants return at once with the texture's place reserved and stream
+// its pixels to the GPU through staging buffers over the next frame or two,
+// so loading mid-session doesn't stall a frame. On the GL backend draws of the
+// texture are skipped until IsTextureReady. rgba is copied; free it any time.
+Texture LoadTextureAsync(const char* path);
+Texture LoadTextureFromPixelsAsync(const unsigned char* rgba, int width, int height);
+bool IsTextureReady(Texture t);
+void DrawTexture(Texture, int x, int y, Color tint);
+void DrawTextureRect(Texture, int x, int y, int w, int h, Color tint); // negative w/h mirror
+
+// Render textures are textures that draws can be redirected into. Between
+// BeginTextureMode and EndTextureMode (inside Begin2D/End2D) draws land in the
+// target, in its own top-left pixel space, starting transparent and without
+// the frame's clip rects or draw layer; draws queued before are drawn first.
+// Draw the result like any texture. Resizing leaves the contents undefined.
+Texture LoadRenderTexture(int width, int height);
+bool ResizeRenderTexture(Texture*, int width, int height); // in place when it fits, same id
+void BeginTextureMode(Texture target);
+void EndTextureMode(void);
+
+// Text. TrueType fonts are loaded into slots 0..15, the id Clay carries as
+// fontId. Glyphs are rasterized on first use per pixel size into the same
+// texture array as sprites, so text batches with them. Sizes are pixel
+// heights (ascender to descender); length < 0 means NUL-terminated UTF-8.
+// Glyph bitmaps are capped at 32 MB: beyond that, or when the texture budget
+// refuses one, the least recently drawn are unloaded and rasterized again on
+// next use. A glyph that still doesn't fit draws blank until a later retry.
+typedef struct TextSize { float width, height; } TextSize;
+
+bool LoadFont(int fontId, const char* path);
+bool LoadFontFromMemory(int fontId, const unsigned char* ttf, size_t size); // copies the data
+void UnloadFonts(void); // also done by RendererShutdown
+TextSize MeasureText(int fontId, const char* text, int length, int fontSize, int letterSpacing);
+void DrawText(int fontId, const char* text, int length, int x, int y, int fontSize, int letterSpacing, Color color); // x, y: top-left
 
 void ClearBackground();
 void Begin2D(int ,int);
 void End2D(void);
+void Flush2D(void);
+
+// Dynamic resolution. Begin2D renders into an offscreen target scaled so that
+// frame time (the larger of FrameStats cpuMs and gpuMs) stays near targetMs,
+// never below minScale, and End2D upscales it into the framebuffer. Draws
+// after BeginNativeResolution (text, crisp lines) skip the scaling and land
+// on top of the scaled part of the frame. Draw coordinates never change.
+void SetDynamicResolution(bool enabled, double targetMs, float minScale);
+float GetResolutionScale(void); // the current frame's; 1 when not scaling
+void BeginNativeResolution(void);
+
+// Draws are queued and sorted at End2D. Higher layers draw on top; within a
+// layer submission order is kept wherever draws overlap, while
+// non-overlapping rects and sprites are grouped to minimise batch flushes.
+void SetDrawLayer(int); // 0..255, reset to 0 by End2D
+
+// Clip rects nest (each intersects the enclosing one) and are applied in the
+// shaders, so they never split a batch. The stack is cleared by End2D.
+void BeginScissor(int x, int y, int w, int h);
+void EndScissor(void);
+
+// Draw capture. BeginCapture writes each following Begin2D..End2D frame's
+// rect, scissor, layer and flush calls (including those DrawClayCommands
+// makes) to a compact binary log, one whole frame per End2D. Sprites, text
+// and draws into render textures are not recorded; elements marked with
+// SetClayElementCached draw in place while capturing, so their rects are
+// recorded like any others. src/replay.c plays a log back for repeatable
+// benchmarks; ReplayCaptureFrame issues one frame's calls, Begin2D through
+// End2D, and returns false after the last.
+bool BeginCapture(const char* path); // truncates path
+void EndCapture(void);               // also done by RendererShutdown
+bool IsCapturing(void);
+
+typedef struct CaptureReplay CaptureReplay;
+typedef struct CaptureInfo { int frames; int width, height; } CaptureInfo; // largest frame size
+
+CaptureReplay* LoadCapture(const char* path); // NULL if missing or corrupt
+void UnloadCapture(CaptureReplay*);
+CaptureInfo GetCaptureInfo(const CaptureReplay*);
+bool ReplayCaptureFrame(CaptureReplay*);
+void RewindCapture(CaptureReplay*);
 void RendererInit(void);
 void RendererShutdown(void);
 
+// Backends. The software backend rasterizes the same draw queue on the CPU
+// (SIMD spans, one band of rows per thread) into an RGBA8 buffer you own.
+// Select it before RendererInit to run with no GL context at all; otherwise
+// both backends can be switched between frames, e.g. for pixel comparisons;
+// sprites are filtered bilinearly with the GL path's edge clamp, so scaled
+// sprites match it to within rounding.
+// Sprites need the image's pixels on the CPU: textures loaded after the
+// software backend was first selected keep a copy.
+typedef enum RenderBackend {
+    RENDER_BACKEND_GL,       // default
+    RENDER_BACKEND_SOFTWARE
+} RenderBackend;
+
+void SetRenderBackend(RenderBackend);
+RenderBackend GetRenderBackend(void);
+void SetSoftwareTarget(unsigned char* rgba, int width, int height, int strideBytes); // top-down; stride 0 = width * 4
+void ClearSoftwareTarget(Color);
+
 // Clay 
 void HandleClayErrors(Clay_ErrorData);
+void DrawClayCommands(Clay_RenderCommandArray); // Clay IMAGE imageData is a Texture*
+// Install with Clay_SetMeasureTextFunction(MeasureClayText, NULL)
+Clay_Dimensions MeasureClayText(Clay_StringSlice text, Clay_TextElementConfig* config, void* userData);
+
+// Retained frames: hashes the command stream and framebuffer size and returns
+// false when both match the last frame it returned true for, so the caller
+// can skip Begin2D..End2D and the buffer swap. Custom commands hash only their
+// pointer; call InvalidateClayFrame when such content, or the window contents
+// (e.g. a GLFW refresh callback), need redrawing.
+bool ClayFrameChanged(Clay_RenderCommandArray cmds, int fbWidth, int fbHeight);
+void InvalidateClayFrame(void);
+
+// Cached elements: once a marked element's subtree has drawn the same for two
+// frames (compared relative to the element, so moving it is free) it is drawn
+// into a render texture and composited as one quad until it changes. The
+// subtree is the run of commands inside the element's box, so siblings that
+// overlap the box end it early. Images hash like ClayFrameChanged; call
+// InvalidateClayCache when their pixels change. Uncaching an element unloads
+// its texture; ReleaseClayCache unloads them all but keeps the marks.
+void SetClayElementCached(Clay_ElementId id, bool cached);
+void InvalidateClayCache(void);
+void ReleaseClayCache(void); // also done by RendererShutdown
+
+// Under dynamic resolution, draw Clay text and cached elements at native
+// resolution: they are drawn after the rest of the commands, on top of them,
+// via BeginNativeResolution.
+void SetClayTextNative(bool native);
 
 // GLFW
 void error_callback(int, const char*);
-void SunburstInit();
\ No newline at end of file
+
+typedef enum SunburstMode {
+    SUNBURST_WINDOWED, // GLFW; create a window with glfwCreateWindow next
+    SUNBURST_HEADLESS  // surfaceless EGL + offscreen FBO, no X server or GPU needed (Linux)
+} SunburstMode;
+
+// Windowed mode sets the GLFW context hints. Headless mode creates and makes
+// current a GL 3.3 core context; size its framebuffer with SetHeadlessSize,
+// then RendererInit and Begin2D/End2D work exactly as with a window.
+bool SunburstInit(SunburstMode mode);
+void SunburstShutdown(void);
+bool SetHeadlessSize(int width, int height); // (re)allocates and binds the offscreen target
+void ReadFramebufferPixels(int x, int y, int width, int height, unsigned char* rgba); // top-down RGBA8
\ No newline at end of file
@@ -1,23 +1,69 @@
+#include "sunburst.h"
+// Decoded images are charged to MEM_TEXTURES
+#define STBI_MALLOC(sz)        MemAlloc(MEM_TEXTURES, sz)
+#define STBI_REALLOC(p, newsz) MemRealloc(MEM_TEXTURES, p, newsz)
+#define STBI_FREE(p)           MemFree(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#include "sunburst.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+// SIMD level for the CPU-side packing and software raster paths, fixed at compile time
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+  #define SIMD_NEON 1
+#endif
 
 // Attribute locations
 #define ATTR_POS   0
 #define ATTR_COLOR 1
-#define ATTR_UV    1 // reuse location 1 for uv in the textured pipeline
+
+// Instanced quad attribute locations (rects and sprites)
+#define ATTR_CORNER 0
+#define ATTR_RECT   1
+#define ATTR_ICOLOR 2
+#define ATTR_RSIZE  3
+#define ATTR_UV     4 // sprite source rect in layer pixels
+#define ATTR_LAYER  5 // sprite texture-array layer
+#define ATTR_CLIP   6 // index into the clip rect table
+#define ATTR_RADII  7 // rect corner radii (TL, TR, BL, BR)
+#define ATTR_BORDER 8 // rect border widths (L, R, T, B)
+#define ATTR_DEPTH  9 // depth-pass z, normalized uint16
+#define ATTR_FLAGS 10 // sprite flags (SPRITE_PREMULTIPLIED)
 
 // Shaders
+// Positions arrive in framebuffer pixels (origin top-left); uViewport is set by Begin2D.
 static const char* s_rectVS =
 "#version 330 core\n"
+"uniform vec2 uViewport;\n"
 "in vec2 pos;\n"
 "in vec4 inColor;\n"
 "out vec4 vColor;\n"
-"void main(){ vColor = inColor; gl_Position = vec4(pos, 0.0, 1.0); }\n";
+"out float gl_ClipDistance[4];\n"
+"void main(){\n"
+"  vColor = inColor;\n"
+"  vec2 ndc = pos * (2.0 / uViewport) - 1.0;\n"
+"  gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);\n"
+"  for (int i = 0; i < 4; ++i) gl_ClipDistance[i] = 1.0; // clipped on the CPU\n"
+"}\n";
 
 static const char* s_rectFS =
 "#version 330 core\n"
@@ -25,6 +71,82 @@ static const char* s_rectFS =
 "out vec4 outColor;\n"
 "void main(){ outColor = vColor; }\n";
 
+// Clip rects live in a texture buffer (x0, y0, x1, y1 pixels); the instanced
+// pipelines clip against them with clip distances, so no scissor state.
+#define CLIP_GLSL \
+"uniform isamplerBuffer uClips;\n" \
+"out float gl_ClipDistance[4];\n" \
+"void apply_clip(vec2 p, float id){\n" \
+"  vec4 c = vec4(texelFetch(uClips, int(id)));\n" \
+"  gl_ClipDistance[0] = p.x - c.x; gl_ClipDistance[1] = c.z - p.x;\n" \
+"  gl_ClipDistance[2] = p.y - c.y; gl_ClipDistance[3] = c.w - p.y;\n" \
+"}\n"
+
+// Instanced rect: unit quad corner per vertex, rect + color per instance
+static const char* s_rectInstVS =
+"#version 330 core\n"
+CLIP_GLSL
+"uniform vec2 uViewport;\n"
+"in vec2 corner;\n"
+"in vec2 rect;\n"
+"in vec2 rectSize;\n"
+"in vec4 inColor;\n"
+"in float clipId;\n"
+"in vec4 inRadii;\n"
+"in vec4 inBorder;\n"
+"in float inDepth;\n"
+"out vec4 vColor;\n"
+"out vec2 vLocal;\n"
+"flat out vec2 vSize;\n"
+"flat out vec4 vRadii;\n"
+"flat out vec4 vBorder;\n"
+"void main(){\n"
+"  vColor = inColor;\n"
+"  vLocal = corner * rectSize;\n"
+"  vSize = rectSize;\n"
+"  vRadii = inRadii;\n"
+"  vBorder = inBorder;\n"
+"  vec2 p = rect + vLocal;\n"
+"  apply_clip(p, clipId);\n"
+"  vec2 ndc = p * (2.0 / uViewport) - 1.0;\n"
+"  gl_Position = vec4(ndc.x, -ndc.y, inDepth * 2.0 - 1.0, 1.0);\n"
+"}\n";
+
+// Rounded corners and borders are resolved analytically on the one quad:
+// coverage of the outer rounded box minus coverage of the box inset by the
+// border widths. Flat, borderless rects skip the distance math entirely.
+// uScale is target pixels per framebuffer pixel (below 1 under dynamic
+// resolution), keeping the antialiasing ramp one target pixel wide.
+static const char* s_rectInstFS =
+"#version 330 core\n"
+"uniform float uScale;\n"
+"in vec4 vColor;\n"
+"in vec2 vLocal;\n"
+"flat in vec2 vSize;\n"
+"flat in vec4 vRadii;\n"
+"flat in vec4 vBorder;\n"
+"out vec4 outColor;\n"
+"float box_sdf(vec2 p, vec2 lo, vec2 hi, vec4 r){\n"
+"  vec2 c = 0.5 * (lo + hi), h = 0.5 * (hi - lo);\n"
+"  float k = p.y < c.y ? (p.x < c.x ? r.x : r.y) : (p.x < c.x ? r.z : r.w);\n"
+"  k = min(k, min(h.x, h.y));\n"
+"  vec2 q = abs(p - c) - h + k;\n"
+"  return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - k;\n"
+"}\n"
+"void main(){\n"
+"  if (vRadii == vec4(0.0) && vBorder == vec4(0.0)) { outColor = vColor; return; }\n"
+"  float cover = clamp(0.5 - box_sdf(vLocal, vec2(0.0), vSize, vRadii) * uScale, 0.0, 1.0);\n"
+"  if (vBorder != vec4(0.0)) {\n"
+"    vec2 lo = vBorder.xz, hi = vSize - vBorder.yw;\n"
+"    vec4 inner = max(vRadii - vec4(max(vBorder.x, vBorder.z), max(vBorder.y, vBorder.z),\n"
+"                                   max(vBorder.x, vBorder.w), max(vBorder.y, vBorder.w)), 0.0);\n"
+"    float hole = (hi.x > lo.x && hi.y > lo.y) ? clamp(0.5 - box_sdf(vLocal, lo, hi, inner) * uScale, 0.0, 1.0) : 0.0;\n"
+"    cover *= 1.0 - hole;\n"
+"  }\n"
+"  if (cover <= 0.0) discard;\n"
+"  outColor = vec4(vColor.rgb, vColor.a * cover);\n"
+"}\n";
+
 
 // Common utilities
 static GLuint compile_shader(GLenum type, const char* src) {
@@ -59,9 +181,9 @@ static GLuint link_program(GLuint vs, GLuint fs, BindAttribsFn bind_attribs) {
     return p;
 }
 
-static void build_quad_indices(GLuint* dst, size_t quadCount) {
+static void build_quad_indices(GLushort* dst, size_t quadCount) {
     for (size_t i = 0; i < quadCount; ++i) {
-        const GLuint base = (GLuint)(i * 4);
+        const GLushort base = (GLushort)(i * 4);
         const size_t o = i * 6;
         dst[o + 0] = base + 0;
         dst[o + 1] = base + 1;
@@ -72,22 +194,474 @@ static void build_quad_indices(GLuint* dst, size_t quadCount) {
     }
 }
 
+// GL state cache
+// Shadow copies of the bindings and fixed-function state the renderer uses.
+// Setters skip calls that would not change anything and count both cases.
+// Bindings owned by a VAO (attribute pointers, element buffer) are set once
+// with that VAO bound and are not tracked. GL state changed behind the
+// renderer's back must be followed by ResetGLStateCache.
+#define GLS_UNKNOWN   0xFFFFFFFFu
+#define GLS_TEX_UNITS 2 // 0: sprite array, 1: clip table
+#define GLS_CAPS      8 // blend, depth, scissor, cull, clip distances 0..3
+
+typedef enum GLSBuffer { GLS_ARRAY_BUFFER, GLS_TEXTURE_BUFFER, GLS_PIXEL_UNPACK_BUFFER, GLS_BUFFERS } GLSBuffer;
+typedef enum GLSTexTarget { GLS_TEX_2D_ARRAY, GLS_TEX_BUFFER, GLS_TEX_TARGETS } GLSTexTarget;
+
+typedef struct GLStateCache {
+    GLuint program;
+    GLuint vao;
+    GLuint buffer[GLS_BUFFERS];
+    GLuint activeUnit;
+    GLuint texture[GLS_TEX_UNITS][GLS_TEX_TARGETS];
+    signed char caps[GLS_CAPS];   // -1 unknown, 0 off, 1 on
+    GLenum blendSrc, blendDst, blendSrcA, blendDstA;
+    GLenum depthFunc;
+    signed char depthMask;
+    GLint  viewport[4];
+
+    unsigned long long issued;    // calls passed through to GL
+    unsigned long long skipped;   // redundant calls filtered out
+} GLStateCache;
+
+static GLStateCache s_gl = {0};
+
+static void glstate_reset(void) {
+    const unsigned long long issued = s_gl.issued, skipped = s_gl.skipped;
+    memset(&s_gl, 0xFF, sizeof s_gl); // GLS_UNKNOWN / -1 everywhere
+    s_gl.issued = issued;
+    s_gl.skipped = skipped;
+}
+
+// True (and counted as issued) when the shadow value changes
+static inline bool glstate_set(GLuint* shadow, GLuint v) {
+    if (*shadow == v) { s_gl.skipped++; return false; }
+    *shadow = v;
+    s_gl.issued++;
+    return true;
+}
+
+static inline void gl_use_program(GLuint p) {
+    if (glstate_set(&s_gl.program, p)) glUseProgram(p);
+}
+
+static inline void gl_bind_vao(GLuint vao) {
+    if (glstate_set(&s_gl.vao, vao)) glBindVertexArray(vao);
+}
+
+static inline void gl_bind_buffer(GLSBuffer slot, GLuint buf) {
+    static const GLenum targets[GLS_BUFFERS] = { GL_ARRAY_BUFFER, GL_TEXTURE_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+    if (glstate_set(&s_gl.buffer[slot], buf)) glBindBuffer(targets[slot], buf);
+}
+
+static inline void gl_bind_texture(GLuint unit, GLSTexTarget target, GLuint tex) {
+    static const GLenum targets[GLS_TEX_TARGETS] = { GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER };
+    if (s_gl.texture[unit][target] == tex) { s_gl.skipped++; return; }
+    if (glstate_set(&s_gl.activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+    s_gl.texture[unit][target] = tex;
+    s_gl.issued++;
+    glBindTexture(targets[target], tex);
+}
+
+static int glstate_cap_slot(GLenum cap) {
+    switch (cap) {
+        case GL_BLEND:        return 0;
+        case GL_DEPTH_TEST:   return 1;
+        case GL_SCISSOR_TEST: return 2;
+        case GL_CULL_FACE:    return 3;
+        default:
+            if (cap >= GL_CLIP_DISTANCE0 && cap < GL_CLIP_DISTANCE0 + 4) return 4 + (int)(cap - GL_CLIP_DISTANCE0);
+            return -1;
+    }
+}
+
+static inline void gl_enable(GLenum cap, bool on) {
+    const int slot = glstate_cap_slot(cap);
+    if (slot >= 0) {
+        if (s_gl.caps[slot] == (signed char)on) { s_gl.skipped++; return; }
+        s_gl.caps[slot] = (signed char)on;
+    }
+    s_gl.issued++;
+    if (on) glEnable(cap);
+    else    glDisable(cap);
+}
+
+static inline void gl_blend_func_separate(GLenum src, GLenum dst, GLenum srcA, GLenum dstA) {
+    if (s_gl.blendSrc == src && s_gl.blendDst == dst &&
+        s_gl.blendSrcA == srcA && s_gl.blendDstA == dstA) { s_gl.skipped++; return; }
+    s_gl.blendSrc = src;
+    s_gl.blendDst = dst;
+    s_gl.blendSrcA = srcA;
+    s_gl.blendDstA = dstA;
+    s_gl.issued++;
+    glBlendFuncSeparate(src, dst, srcA, dstA);
+}
+
+static inline void gl_blend_func(GLenum src, GLenum dst) {
+    gl_blend_func_separate(src, dst, src, dst);
+}
+
+static inline void gl_depth_func(GLenum func) {
+    if (glstate_set(&s_gl.depthFunc, func)) glDepthFunc(func);
+}
+
+static inline void gl_depth_mask(bool on) {
+    if (s_gl.depthMask == (signed char)on) { s_gl.skipped++; return; }
+    s_gl.depthMask = (signed char)on;
+    s_gl.issued++;
+    glDepthMask(on ? GL_TRUE : GL_FALSE);
+}
+
+static inline void gl_viewport(GLint x, GLint y, GLint w, GLint h) {
+    GLint* v = s_gl.viewport;
+    if (v[0] == x && v[1] == y && v[2] == w && v[3] == h) { s_gl.skipped++; return; }
+    v[0] = x; v[1] = y; v[2] = w; v[3] = h;
+    s_gl.issued++;
+    glViewport(x, y, w, h);
+}
+
+// Deleting a bound object unbinds it; keep the shadow in step so a recycled
+// name is never mistaken for the old binding.
+static void gl_delete_buffer(GLuint* buf) {
+    if (!*buf) return;
+    for (int i = 0; i < GLS_BUFFERS; ++i) if (s_gl.buffer[i] == *buf) s_gl.buffer[i] = 0;
+    glDeleteBuffers(1, buf);
+    *buf = 0;
+}
+
+static void gl_delete_texture(GLuint* tex) {
+    if (!*tex) return;
+    for (int u = 0; u < GLS_TEX_UNITS; ++u)
+        for (int t = 0; t < GLS_TEX_TARGETS; ++t) if (s_gl.texture[u][t] == *tex) s_gl.texture[u][t] = 0;
+    glDeleteTextures(1, tex);
+    *tex = 0;
+}
+
+static void gl_delete_vao(GLuint* vao) {
+    if (!*vao) return;
+    if (s_gl.vao == *vao) s_gl.vao = 0;
+    glDeleteVertexArrays(1, vao);
+    *vao = 0;
+}
+
+static void gl_delete_program(GLuint* prog) {
+    if (!*prog) return;
+    if (s_gl.program == *prog) s_gl.program = GLS_UNKNOWN; // deletion is deferred while in use
+    glDeleteProgram(*prog);
+    *prog = 0;
+}
+
 // Framebuffer cache
 static int s_fbW = 0, s_fbH = 0;
 
+// Active backend. GL objects only exist if RendererInit ran with the GL
+// backend selected; a software-only renderer needs no GL context at all.
+static RenderBackend s_backend = RENDER_BACKEND_GL;
+static bool s_glReady = false;
+
+// Static unit quad shared by the instanced pipelines.
+// Corners in [0,1]^2 as a triangle strip, same winding as the indexed V0..V3.
+static GLuint s_unitQuadVbo = 0;
+
+static const float s_unitQuad[8] = { 0,0,  0,1,  1,0,  1,1 };
+
+static void unit_quad_init(void) {
+    glGenBuffers(1, &s_unitQuadVbo);
+    gl_bind_buffer(GLS_ARRAY_BUFFER, s_unitQuadVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof s_unitQuad, s_unitQuad, GL_STATIC_DRAW);
+    MemTrackGpu(MEM_GPU_BUFFERS, sizeof s_unitQuad);
+}
+
+static void unit_quad_bind(void) {
+    gl_bind_buffer(GLS_ARRAY_BUFFER, s_unitQuadVbo);
+    glEnableVertexAttribArray(ATTR_CORNER);
+    glVertexAttribPointer(ATTR_CORNER, 2, GL_FLOAT, GL_FALSE, sizeof(float)*2, (void*)0);
+}
+
+// Static 16-bit quad indices shared by the indexed quad pipelines.
+// Built once for QUAD_INDEX_QUADS quads, the most 16-bit indices can address;
+// longer batches draw in chunks with a base vertex, so batch growth never
+// touches the index buffer.
+#define QUAD_INDEX_QUADS 16384
+#define QUAD_INDEX_BYTES (QUAD_INDEX_QUADS * 6 * sizeof(GLushort))
+
+static GLuint s_quadIbo = 0;
+
+static void quad_indices_init(void) {
+    GLushort* indices = (GLushort*)FrameAlloc(QUAD_INDEX_BYTES);
+    if (!indices) {
+        fprintf(stderr, "Out of memory building quad indices.\n");
+        return;
+    }
+    build_quad_indices(indices, QUAD_INDEX_QUADS);
+    glGenBuffers(1, &s_quadIbo);
+    // Filled through a binding point that isn't VAO state
+    glBindBuffer(GL_COPY_WRITE_BUFFER, s_quadIbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, QUAD_INDEX_BYTES, indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    MemTrackGpu(MEM_GPU_BUFFERS, QUAD_INDEX_BYTES);
+}
+
+// The element binding is VAO state: call with the pipeline's VAO bound
+static void quad_indices_bind(void) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_quadIbo);
+}
+
+// Draws quadCount quads of 4 streamed vertices each, from the current layout
+static void quad_indices_draw(size_t quadCount) {
+    for (size_t first = 0; first < quadCount; first += QUAD_INDEX_QUADS) {
+        const size_t n = quadCount - first < QUAD_INDEX_QUADS ? quadCount - first : QUAD_INDEX_QUADS;
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)(n * 6), GL_UNSIGNED_SHORT, (void*)0, (GLint)(first * 4));
+    }
+}
+
+// Streaming ring buffer
+// One GL buffer split into RING_REGIONS regions. Each flush maps the next free
+// range of the current region unsynchronized and copies staging data into it;
+// when a region fills (or a frame ends) it is fenced and writing moves on. A
+// region is only rewritten after its fence has signaled, so the driver never
+// has to copy or orphan storage behind our back.
+#define RING_REGIONS      3
+#define RING_ALIGN        64
+#define RING_REGION_BYTES (1u << 20)
+
+typedef struct StreamRing {
+    GLuint buf;
+    size_t regionBytes;
+    int    region;                // region currently being written
+    size_t head;                  // write offset within that region
+    GLsync fence[RING_REGIONS];   // pending GPU reads per region
+} StreamRing;
+
+static StreamRingStats s_ringStats = {0};
+
+static void ring_init(StreamRing* r, size_t regionBytes) {
+    memset(r, 0, sizeof *r);
+    r->regionBytes = regionBytes;
+    glGenBuffers(1, &r->buf);
+    gl_bind_buffer(GLS_ARRAY_BUFFER, r->buf);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(regionBytes * RING_REGIONS), NULL, GL_STREAM_DRAW);
+    MemTrackGpu(MEM_GPU_BUFFERS, (long long)(regionBytes * RING_REGIONS));
+}
+
+static void ring_drop_fences(StreamRing* r) {
+    for (int i = 0; i < RING_REGIONS; ++i) {
+        if (r->fence[i]) { glDeleteSync(r->fence[i]); r->fence[i] = NULL; }
+    }
+}
+
+static void ring_shutdown(StreamRing* r) {
+    ring_drop_fences(r);
+    if (r->buf) MemTrackGpu(MEM_GPU_BUFFERS, -(long long)(r->regionBytes * RING_REGIONS));
+    gl_delete_buffer(&r->buf);
+    r->regionBytes = r->head = 0;
+}
+
+// Fence the region being written and move to the next one.
+static void ring_advance(StreamRing* r) {
+    if (r->head == 0) return;
+    if (r->fence[r->region]) glDeleteSync(r->fence[r->region]);
+    r->fence[r->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->region = (r->region + 1) % RING_REGIONS;
+    r->head = 0;
+}
+
+static void ring_wait(StreamRing* r) {
+    GLsync f = r->fence[r->region];
+    if (!f) return;
+    if (glClientWaitSync(f, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        s_ringStats.fenceWaits++;
+        while (glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED) {}
+    }
+    glDeleteSync(f);
+    r->fence[r->region] = NULL;
+}
+
+// A single upload larger than a region: reallocate with bigger regions.
+// Re-specifying the store is safe for in-flight draws, so old fences are dropped.
+static void ring_regrow(StreamRing* r, size_t bytes) {
+    size_t newRegion = r->regionBytes ? r->regionBytes : RING_REGION_BYTES;
+    while (newRegion < bytes) newRegion <<= 1;
+
+    ring_drop_fences(r);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(newRegion * RING_REGIONS), NULL, GL_STREAM_DRAW);
+    MemTrackGpu(MEM_GPU_BUFFERS, (long long)((newRegion - r->regionBytes) * RING_REGIONS));
+    r->regionBytes = newRegion;
+    r->region = 0;
+    r->head = 0;
+    s_ringStats.regrows++;
+}
+
+// Copies bytes into the ring and returns the buffer offset they were written at.
+// Leaves the ring bound to GL_ARRAY_BUFFER.
+static size_t ring_write(StreamRing* r, const void* src, size_t bytes) {
+    gl_bind_buffer(GLS_ARRAY_BUFFER, r->buf);
+    if (bytes > r->regionBytes) ring_regrow(r, bytes);
+    else if (r->head + bytes > r->regionBytes) ring_advance(r);
+    ring_wait(r);
+
+    const size_t off = (size_t)r->region * r->regionBytes + r->head;
+    void* dst = glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)off, (GLsizeiptr)bytes,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst) {
+        memcpy(dst, src, bytes);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)off, (GLsizeiptr)bytes, src);
+    }
+
+    r->head = (r->head + bytes + (RING_ALIGN - 1)) & ~(size_t)(RING_ALIGN - 1);
+    s_ringStats.bytesStreamed += bytes;
+    return off;
+}
+
+// Clip rects
+// BeginScissor/EndScissor keep a stack of intersected rects. Each distinct
+// clip gets an id in a per-frame table (0 = unclipped) that queued commands
+// carry per instance, so a UI with many scroll regions stays one batch.
+#define CLIP_STACK_MAX 64
+#define CLIP_TABLE_MAX 65536
+
+typedef struct ClipRect {
+    short x0, y0, x1, y1;
+} ClipRect;
+
+typedef struct ClipState {
+    ClipRect* table;
+    size_t count;
+    size_t cap;
+    size_t uploaded;     // entries the GPU copy holds
+
+    ClipRect stackRect[CLIP_STACK_MAX];
+    unsigned short stackId[CLIP_STACK_MAX];
+    int depth;
+
+    GLuint buf;          // GL_TEXTURE_BUFFER storage
+    size_t bufBytes;     // its size, as reported to MemTrackGpu
+    GLuint tex;          // RGBA16I buffer texture over buf
+} ClipState;
+
+static ClipState s_clip = {0};
+
+static inline ClipRect clip_intersect(ClipRect a, ClipRect b) {
+    ClipRect r = {
+        a.x0 > b.x0 ? a.x0 : b.x0, a.y0 > b.y0 ? a.y0 : b.y0,
+        a.x1 < b.x1 ? a.x1 : b.x1, a.y1 < b.y1 ? a.y1 : b.y1
+    };
+    if (r.x1 < r.x0) r.x1 = r.x0;
+    if (r.y1 < r.y0) r.y1 = r.y0;
+    return r;
+}
+
+static inline unsigned short clip_current(void) {
+    return s_clip.depth ? s_clip.stackId[s_clip.depth - 1] : 0;
+}
+
+static unsigned short clip_register(ClipRect r) {
+    if (s_clip.count == s_clip.cap) {
+        size_t newCap = s_clip.cap ? s_clip.cap * 2 : 64;
+        ClipRect* t = (ClipRect*)MemRealloc(MEM_RENDERER, s_clip.table, newCap * sizeof(ClipRect));
+        if (!t) {
+            fprintf(stderr, "Out of memory growing clip table.\n");
+            return clip_current();
+        }
+        s_clip.table = t;
+        s_clip.cap = newCap;
+    }
+    s_clip.table[s_clip.count] = r;
+    return (unsigned short)s_clip.count++;
+}
+
+// Starts a fresh table holding just the unclipped entry and the live stack.
+static void clip_reset_table(void) {
+    s_clip.count = 0;
+    s_clip.uploaded = 0;
+    clip_register((ClipRect){ -32768, -32768, 32767, 32767 });
+    for (int i = 0; i < s_clip.depth; ++i) s_clip.stackId[i] = clip_register(s_clip.stackRect[i]);
+}
+
+static void clip_track_gpu(size_t bytes) {
+    MemTrackGpu(MEM_GPU_BUFFERS, (long long)bytes - (long long)s_clip.bufBytes);
+    s_clip.bufBytes = bytes;
+}
+
+static void clip_init(void) {
+    if (s_glReady) {
+        glGenBuffers(1, &s_clip.buf);
+        gl_bind_buffer(GLS_TEXTURE_BUFFER, s_clip.buf);
+        glBufferData(GL_TEXTURE_BUFFER, 64 * sizeof(ClipRect), NULL, GL_DYNAMIC_DRAW);
+        clip_track_gpu(64 * sizeof(ClipRect));
+        glGenTextures(1, &s_clip.tex);
+        gl_bind_texture(1, GLS_TEX_BUFFER, s_clip.tex);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA16I, s_clip.buf);
+    }
+    s_clip.depth = 0;
+    clip_reset_table();
+}
+
+static void clip_shutdown(void) {
+    MemFree(s_clip.table); s_clip.table = NULL;
+    s_clip.count = s_clip.cap = s_clip.uploaded = 0;
+    s_clip.depth = 0;
+    gl_delete_texture(&s_clip.tex);
+    gl_delete_buffer(&s_clip.buf);
+    clip_track_gpu(0);
+}
+
+// Makes the table visible to the instanced shaders on texture unit 1.
+static void clip_upload(void) {
+    if (s_clip.uploaded != s_clip.count) {
+        gl_bind_buffer(GLS_TEXTURE_BUFFER, s_clip.buf);
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(s_clip.count * sizeof(ClipRect)), s_clip.table, GL_DYNAMIC_DRAW);
+        clip_track_gpu(s_clip.count * sizeof(ClipRect));
+        s_clip.uploaded = s_clip.count;
+    }
+    gl_bind_texture(1, GLS_TEX_BUFFER, s_clip.tex);
+}
+
 // Rect batch (indexed 4-vertex quads)
-// Vertex layout: [x, y, r, g, b, a]
-#define RECT_VTX_STRIDE_FLOATS 6
+// Vertex layout: int16 pixel x, y + normalized RGBA8 color (8 bytes)
+typedef struct RectVertex {
+    short x, y;
+    unsigned char rgba[4];
+} RectVertex;
+
+// Corner radii (TL, TR, BL, BR) and border widths (L, R, T, B) in pixels.
+// All zero is a plain filled rect; any border makes it a border ring only.
+typedef struct RectShape {
+    unsigned char radius[4];
+    unsigned char border[4];
+} RectShape;
+
+static const RectShape s_flatShape = {{0}, {0}};
+
+// Instanced layout: one record per rect, int16 pixel left/top, uint16 size, RGBA8 color,
+// uint16 clip id, uint16 depth-pass z, shape (24 bytes)
+typedef struct RectInstance {
+    short x, y;
+    unsigned short w, h;
+    unsigned char rgba[4];
+    unsigned short clip, z;
+    RectShape shape;
+} RectInstance;
 
 typedef struct RectBatch {
-    GLuint vbo;
-    GLuint ebo;
+    StreamRing ring;     // streamed vertices / instances for both paths
     GLuint vao;
     GLuint prog;
+    GLint  viewportLoc;
+
+    // Instanced path
+    GLuint instVao;
+    GLuint instProg;
+    GLint  instViewportLoc;
+    GLint  instScaleLoc;
+    RectBatchMode mode;
 
-    size_t capQuads;     // capacity in quads
+    size_t capQuads;     // vtxData capacity in quads
+    size_t capInst;      // instData capacity in quads
     size_t countQuads;   // queued quads
-    float* vtxData;      // CPU staging: 4 verts/quad
+    RectVertex* vtxData; // CPU staging: 4 verts/quad
+    RectInstance* instData; // CPU staging: 1 record/quad
 } RectBatch;
 
 static RectBatch s_rectBatch = {0};
@@ -97,176 +671,3169 @@ static void bind_rect_attribs(GLuint prog) {
     glBindAttribLocation(prog, ATTR_COLOR, "inColor");
 }
 
+static void bind_rect_inst_attribs(GLuint prog) {
+    glBindAttribLocation(prog, ATTR_CORNER, "corner");
+    glBindAttribLocation(prog, ATTR_RECT,   "rect");
+    glBindAttribLocation(prog, ATTR_RSIZE,  "rectSize");
+    glBindAttribLocation(prog, ATTR_ICOLOR, "inColor");
+    glBindAttribLocation(prog, ATTR_CLIP,   "clipId");
+    glBindAttribLocation(prog, ATTR_RADII,  "inRadii");
+    glBindAttribLocation(prog, ATTR_BORDER, "inBorder");
+    glBindAttribLocation(prog, ATTR_DEPTH,  "inDepth");
+}
+
+// Attribute pointers are re-specified per flush to follow the ring write offset
+static void rect_vertex_layout(size_t base) {
+    const GLsizei stride = (GLsizei)sizeof(RectVertex);
+    glVertexAttribPointer(ATTR_POS, 2, GL_SHORT, GL_FALSE, stride, (void*)(base + offsetof(RectVertex, x)));
+    glVertexAttribPointer(ATTR_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(base + offsetof(RectVertex, rgba)));
+}
+
+static void rect_instance_layout(size_t base) {
+    const GLsizei istride = (GLsizei)sizeof(RectInstance);
+    glVertexAttribPointer(ATTR_RECT, 2, GL_SHORT, GL_FALSE, istride, (void*)(base + offsetof(RectInstance, x)));
+    glVertexAttribPointer(ATTR_RSIZE, 2, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(RectInstance, w)));
+    glVertexAttribPointer(ATTR_ICOLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, istride, (void*)(base + offsetof(RectInstance, rgba)));
+    glVertexAttribPointer(ATTR_CLIP, 1, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(RectInstance, clip)));
+    glVertexAttribPointer(ATTR_RADII, 4, GL_UNSIGNED_BYTE, GL_FALSE, istride, (void*)(base + offsetof(RectInstance, shape.radius)));
+    glVertexAttribPointer(ATTR_BORDER, 4, GL_UNSIGNED_BYTE, GL_FALSE, istride, (void*)(base + offsetof(RectInstance, shape.border)));
+    glVertexAttribPointer(ATTR_DEPTH, 1, GL_UNSIGNED_SHORT, GL_TRUE, istride, (void*)(base + offsetof(RectInstance, z)));
+}
+
+static inline unsigned char unorm8(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 1.0f) return 255;
+    return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+static inline short clamp_i16(long long v) {
+    if (v < -32768) return -32768;
+    if (v >  32767) return  32767;
+    return (short)v;
+}
+
 static void rectbatch_init(size_t capQuads) {
     s_rectBatch.capQuads   = capQuads ? capQuads : 2048;
+    s_rectBatch.capInst    = s_rectBatch.capQuads;
     s_rectBatch.countQuads = 0;
-    s_rectBatch.vtxData = (float*)malloc(
-        s_rectBatch.capQuads * 4 * RECT_VTX_STRIDE_FLOATS * sizeof(float));
+    s_rectBatch.vtxData = (RectVertex*)MemAlloc(MEM_RENDERER, 
+        s_rectBatch.capQuads * 4 * sizeof(RectVertex));
+    s_rectBatch.instData = (RectInstance*)MemAlloc(MEM_RENDERER, 
+        s_rectBatch.capInst * sizeof(RectInstance));
+    s_rectBatch.mode = RECT_BATCH_INSTANCED;
 
     // GL objects
     glGenVertexArrays(1, &s_rectBatch.vao);
-    glBindVertexArray(s_rectBatch.vao);
+    gl_bind_vao(s_rectBatch.vao);
 
-    glGenBuffers(1, &s_rectBatch.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, s_rectBatch.vbo);
+    ring_init(&s_rectBatch.ring, RING_REGION_BYTES);
 
-    glGenBuffers(1, &s_rectBatch.ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_rectBatch.ebo);
-
-    // Static EBO up to capacity
-    const size_t indexCount = s_rectBatch.capQuads * 6;
-    GLuint* indices = (GLuint*)malloc(indexCount * sizeof(GLuint));
-    build_quad_indices(indices, s_rectBatch.capQuads);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 (GLsizeiptr)(indexCount * sizeof(GLuint)),
-                 indices, GL_STATIC_DRAW);
-    free(indices);
+    quad_indices_bind();
 
     // Program + vertex layout
     GLuint vs = compile_shader(GL_VERTEX_SHADER,   s_rectVS);
     GLuint fs = compile_shader(GL_FRAGMENT_SHADER, s_rectFS);
     s_rectBatch.prog = link_program(vs, fs, bind_rect_attribs);
+    s_rectBatch.viewportLoc = glGetUniformLocation(s_rectBatch.prog, "uViewport");
     glDeleteShader(vs);
     glDeleteShader(fs);
 
-    const GLsizei stride = (GLsizei)(sizeof(float) * RECT_VTX_STRIDE_FLOATS);
     glEnableVertexAttribArray(ATTR_POS);
-    glVertexAttribPointer(ATTR_POS, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
     glEnableVertexAttribArray(ATTR_COLOR);
-    glVertexAttribPointer(ATTR_COLOR, 4, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)*2));
+    rect_vertex_layout(0);
+
+    // Instanced pipeline
+    glGenVertexArrays(1, &s_rectBatch.instVao);
+    gl_bind_vao(s_rectBatch.instVao);
+    unit_quad_bind();
+
+    gl_bind_buffer(GLS_ARRAY_BUFFER, s_rectBatch.ring.buf);
+    glEnableVertexAttribArray(ATTR_RECT);
+    glVertexAttribDivisor(ATTR_RECT, 1);
+    glEnableVertexAttribArray(ATTR_RSIZE);
+    glVertexAttribDivisor(ATTR_RSIZE, 1);
+    glEnableVertexAttribArray(ATTR_ICOLOR);
+    glVertexAttribDivisor(ATTR_ICOLOR, 1);
+    glEnableVertexAttribArray(ATTR_CLIP);
+    glVertexAttribDivisor(ATTR_CLIP, 1);
+    glEnableVertexAttribArray(ATTR_RADII);
+    glVertexAttribDivisor(ATTR_RADII, 1);
+    glEnableVertexAttribArray(ATTR_BORDER);
+    glVertexAttribDivisor(ATTR_BORDER, 1);
+    glEnableVertexAttribArray(ATTR_DEPTH);
+    glVertexAttribDivisor(ATTR_DEPTH, 1);
+    rect_instance_layout(0);
+
+    vs = compile_shader(GL_VERTEX_SHADER,   s_rectInstVS);
+    fs = compile_shader(GL_FRAGMENT_SHADER, s_rectInstFS);
+    s_rectBatch.instProg = link_program(vs, fs, bind_rect_inst_attribs);
+    s_rectBatch.instViewportLoc = glGetUniformLocation(s_rectBatch.instProg, "uViewport");
+    s_rectBatch.instScaleLoc = glGetUniformLocation(s_rectBatch.instProg, "uScale");
+    gl_use_program(s_rectBatch.instProg);
+    glUniform1i(glGetUniformLocation(s_rectBatch.instProg, "uClips"), 1);
+    glUniform1f(s_rectBatch.instScaleLoc, 1.0f);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
 }
 
 static void rectbatch_shutdown(void) {
-    free(s_rectBatch.vtxData); s_rectBatch.vtxData = NULL;
-    s_rectBatch.capQuads = s_rectBatch.countQuads = 0;
+    MemFree(s_rectBatch.vtxData); s_rectBatch.vtxData = NULL;
+    MemFree(s_rectBatch.instData); s_rectBatch.instData = NULL;
+    s_rectBatch.capQuads = s_rectBatch.capInst = s_rectBatch.countQuads = 0;
 
-    if (s_rectBatch.vbo)  { glDeleteBuffers(1, &s_rectBatch.vbo);  s_rectBatch.vbo = 0; }
-    if (s_rectBatch.ebo)  { glDeleteBuffers(1, &s_rectBatch.ebo);  s_rectBatch.ebo = 0; }
-    if (s_rectBatch.vao)  { glDeleteVertexArrays(1, &s_rectBatch.vao); s_rectBatch.vao = 0; }
+    ring_shutdown(&s_rectBatch.ring);
+    gl_delete_vao(&s_rectBatch.vao);
+    gl_delete_vao(&s_rectBatch.instVao);
     #if defined(_MSC_VER) 
-    if (s_rectBatch.prog) { glDeleteProgram(s_rectBatch.prog); s_rectBatch.prog = 0; }
+    gl_delete_program(&s_rectBatch.prog);
+    gl_delete_program(&s_rectBatch.instProg);
     #elif defined(__APPLE__)
-    if (s_rectBatch.prog) { glDeleteProgram(s_rectBatch.prog); s_rectBatch.prog = 0; }
+    gl_delete_program(&s_rectBatch.prog);
+    gl_delete_program(&s_rectBatch.instProg);
     #endif
 
 }
 
-static void rectbatch_maybe_grow(size_t requiredQuads) {
-    if (requiredQuads <= s_rectBatch.capQuads) return;
+// Each path grows only its own staging array, so a large instanced batch
+// doesn't also reserve four vertices per quad it never writes.
+static bool rectbatch_grow_vertices(size_t requiredQuads) {
+    if (requiredQuads <= s_rectBatch.capQuads) return true;
 
-    size_t newCap = s_rectBatch.capQuads;
+    size_t newCap = s_rectBatch.capQuads ? s_rectBatch.capQuads : 2048;
     while (newCap < requiredQuads) newCap <<= 1;
 
-    float* newV = (float*)realloc(
-        s_rectBatch.vtxData, newCap * 4 * RECT_VTX_STRIDE_FLOATS * sizeof(float));
+    RectVertex* newV = (RectVertex*)MemRealloc(MEM_RENDERER, 
+        s_rectBatch.vtxData, newCap * 4 * sizeof(RectVertex));
     if (!newV) {
         fprintf(stderr, "Out of memory growing rect batch.\n");
-        return;
+        return false;
     }
     s_rectBatch.vtxData = newV;
+    s_rectBatch.capQuads = newCap;
+    return true;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_rectBatch.ebo);
-    const size_t indexCount = newCap * 6;
-    GLuint* indices = (GLuint*)malloc(indexCount * sizeof(GLuint));
-    build_quad_indices(indices, newCap);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 (GLsizeiptr)(indexCount * sizeof(GLuint)),
-                 indices, GL_STATIC_DRAW);
-    free(indices);
+static bool rectbatch_grow_instances(size_t requiredQuads) {
+    if (requiredQuads <= s_rectBatch.capInst) return true;
 
-    s_rectBatch.capQuads = newCap;
+    size_t newCap = s_rectBatch.capInst ? s_rectBatch.capInst : 2048;
+    while (newCap < requiredQuads) newCap <<= 1;
+
+    RectInstance* newI = (RectInstance*)MemRealloc(MEM_RENDERER, 
+        s_rectBatch.instData, newCap * sizeof(RectInstance));
+    if (!newI) {
+        fprintf(stderr, "Out of memory growing rect batch.\n");
+        return false;
+    }
+    s_rectBatch.instData = newI;
+    s_rectBatch.capInst = newCap;
+    return true;
+}
+
+static void rectbatch_flush_instanced(void) {
+    const size_t iBytes = s_rectBatch.countQuads * sizeof(RectInstance);
+
+    gl_use_program(s_rectBatch.instProg);
+    gl_bind_vao(s_rectBatch.instVao);
+
+    const size_t base = ring_write(&s_rectBatch.ring, s_rectBatch.instData, iBytes);
+    rect_instance_layout(base);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)s_rectBatch.countQuads);
+
+    s_rectBatch.countQuads = 0;
 }
 
 static void rectbatch_flush(void) {
     if (s_rectBatch.countQuads == 0) return;
+    if (s_rectBatch.mode == RECT_BATCH_INSTANCED) { rectbatch_flush_instanced(); return; }
 
     const size_t vCount = s_rectBatch.countQuads * 4;
-    const size_t vBytes = vCount * RECT_VTX_STRIDE_FLOATS * sizeof(float);
-    const size_t iCount = s_rectBatch.countQuads * 6;
+    const size_t vBytes = vCount * sizeof(RectVertex);
 
-    glUseProgram(s_rectBatch.prog);
-    glBindVertexArray(s_rectBatch.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, s_rectBatch.vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_rectBatch.ebo);
+    gl_use_program(s_rectBatch.prog);
+    gl_bind_vao(s_rectBatch.vao); // carries the element buffer
 
     // Stream vertices for the quads enqueued
-    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vBytes, NULL, GL_STREAM_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)vBytes, s_rectBatch.vtxData);
+    const size_t base = ring_write(&s_rectBatch.ring, s_rectBatch.vtxData, vBytes);
+    rect_vertex_layout(base);
 
-    glDrawElements(GL_TRIANGLES, (GLsizei)iCount, GL_UNSIGNED_INT, (void*)0);
+    quad_indices_draw(s_rectBatch.countQuads);
 
     s_rectBatch.countQuads = 0;
 }
 
 static inline void rectbatch_push(int x, int y, int w, int h,
-                                  float r, float g, float b, float a) {
+                                  float r, float g, float b, float a, unsigned short clip,
+                                  unsigned short z, RectShape shape) {
     if (w == 0 || h == 0 || s_fbW <= 0 || s_fbH <= 0) return;
     if (w < 0) { x += w; w = -w; }
     if (h < 0) { y += h; h = -h; }
 
+    // The indexed path has no distance field: borders become four edge
+    // strips (exact for square corners) and corner radii are ignored.
+    if (s_rectBatch.mode == RECT_BATCH_INDEXED && (shape.border[0] | shape.border[1] | shape.border[2] | shape.border[3])) {
+        const int bl = shape.border[0], br = shape.border[1], bt = shape.border[2], bb = shape.border[3];
+        rectbatch_push(x, y, w, bt, r, g, b, a, clip, z, s_flatShape);
+        rectbatch_push(x, y + h - bb, w, bb, r, g, b, a, clip, z, s_flatShape);
+        if (h - bt - bb > 0) {
+            rectbatch_push(x, y + bt, bl, h - bt - bb, r, g, b, a, clip, z, s_flatShape);
+            rectbatch_push(x + w - br, y + bt, br, h - bt - bb, r, g, b, a, clip, z, s_flatShape);
+        }
+        return;
+    }
+
     const size_t need = s_rectBatch.countQuads + 1;
-    if (need > s_rectBatch.capQuads) {
-        rectbatch_maybe_grow(need);
-        if (need > s_rectBatch.capQuads) return; // OOM guard
+    const bool room = s_rectBatch.mode == RECT_BATCH_INSTANCED ? rectbatch_grow_instances(need)
+                                                               : rectbatch_grow_vertices(need);
+    if (!room) return; // OOM guard
+
+    // Pixel edges, clamped to the int16 range the vertex format can hold.
+    // The shader maps pixels to NDC, so no per-rect divides here.
+    short L = clamp_i16(x), R = clamp_i16((long)x + w);
+    short T = clamp_i16(y), B = clamp_i16((long)y + h);
+    const unsigned char c[4] = { unorm8(r), unorm8(g), unorm8(b), unorm8(a) };
+
+    if (s_rectBatch.mode == RECT_BATCH_INSTANCED) {
+        RectInstance* inst = s_rectBatch.instData + s_rectBatch.countQuads;
+        inst->x = L; inst->y = T;
+        inst->w = (unsigned short)(R - L); inst->h = (unsigned short)(B - T);
+        memcpy(inst->rgba, c, 4);
+        inst->clip = clip;
+        inst->z = z;
+        inst->shape = shape;
+        s_rectBatch.countQuads += 1;
+        return;
     }
 
-    // Pixel -> NDC (origin: top-left)
-    const float L =  2.0f * ((float)x        / (float)s_fbW) - 1.0f;
-    const float R =  2.0f * ((float)(x + w)  / (float)s_fbW) - 1.0f;
-    const float T =  1.0f - 2.0f * ((float)y        / (float)s_fbH);
-    const float B =  1.0f - 2.0f * ((float)(y + h)  / (float)s_fbH);
+    // Solid quads clip exactly on the CPU
+    const ClipRect cr = clip_intersect((ClipRect){ L, T, R, B }, s_clip.table[clip]);
+    if (cr.x0 == cr.x1 || cr.y0 == cr.y1) return;
+    L = cr.x0; T = cr.y0; R = cr.x1; B = cr.y1;
 
-    float* v = s_rectBatch.vtxData + (s_rectBatch.countQuads * 4 * RECT_VTX_STRIDE_FLOATS);
+    RectVertex* v = s_rectBatch.vtxData + (s_rectBatch.countQuads * 4);
 
     // V0 (L,T)
-    v[0]=L; v[1]=T; v[2]=r; v[3]=g; v[4]=b; v[5]=a;
+    v[0].x = L; v[0].y = T; memcpy(v[0].rgba, c, 4);
     // V1 (L,B)
-    v[6]=L; v[7]=B; v[8]=r; v[9]=g; v[10]=b; v[11]=a;
+    v[1].x = L; v[1].y = B; memcpy(v[1].rgba, c, 4);
     // V2 (R,T)
-    v[12]=R; v[13]=T; v[14]=r; v[15]=g; v[16]=b; v[17]=a;
+    v[2].x = R; v[2].y = T; memcpy(v[2].rgba, c, 4);
     // V3 (R,B)
-    v[18]=R; v[19]=B; v[20]=r; v[21]=g; v[22]=b; v[23]=a;
+    v[3].x = R; v[3].y = B; memcpy(v[3].rgba, c, 4);
 
     s_rectBatch.countQuads += 1;
 }
 
-// Public API
-void RendererInit(void) {
-    rectbatch_init(2048);
-    texbatch_init(2048);
-    s_fbW = s_fbH = 0;
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+// a + b saturated to int32, which SSE2 lacks: an overflowed sum has the sign
+// of neither input and becomes INT_MAX or INT_MIN by a's sign
+static inline __m128i adds_epi32(__m128i a, __m128i b) {
+    const __m128i sum = _mm_add_epi32(a, b);
+    const __m128i ovf = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(sum, a), _mm_xor_si128(sum, b)), 31);
+    const __m128i sat = _mm_xor_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(0x7FFFFFFF));
+    return _mm_or_si128(_mm_andnot_si128(ovf, sum), _mm_and_si128(ovf, sat));
+}
+#endif
+
+// Packs n flat rects from structure-of-arrays input straight into instance
+// records, four at a time: negative sizes flipped, edges saturated to int16
+// and colors rounded to RGBA8 exactly as rectbatch_push does. Each edge is
+// one add, x + min(w, 0) or x + max(w, 0), saturated to int32 in the lanes
+// and exact in the tail, so both land on the same int16 for any input.
+static void rect_pack_instances(RectInstance* out, const int* x, const int* y, const int* w, const int* h,
+                                const Color* colors, size_t n, unsigned short clip) {
+    size_t i = 0;
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= n; i += 4) {
+        const __m128i xv = _mm_loadu_si128((const __m128i*)(x + i)), wv = _mm_loadu_si128((const __m128i*)(w + i));
+        const __m128i yv = _mm_loadu_si128((const __m128i*)(y + i)), hv = _mm_loadu_si128((const __m128i*)(h + i));
+        const __m128i wneg = _mm_srai_epi32(wv, 31), hneg = _mm_srai_epi32(hv, 31);
+        const __m128i L = adds_epi32(xv, _mm_and_si128(wv, wneg));
+        const __m128i T = adds_epi32(yv, _mm_and_si128(hv, hneg));
+        const __m128i R = adds_epi32(xv, _mm_andnot_si128(wneg, wv));
+        const __m128i B = adds_epi32(yv, _mm_andnot_si128(hneg, hv));
+        const __m128i LT = _mm_packs_epi32(L, T);                // L0..L3 T0..T3, saturated
+        const __m128i WH = _mm_sub_epi16(_mm_packs_epi32(R, B), LT);
+        const __m128i lt = _mm_unpacklo_epi16(LT, _mm_srli_si128(LT, 8));
+        const __m128i wh = _mm_unpacklo_epi16(WH, _mm_srli_si128(WH, 8));
+        unsigned long long geo[4];
+        _mm_storeu_si128((__m128i*)&geo[0], _mm_unpacklo_epi32(lt, wh));
+        _mm_storeu_si128((__m128i*)&geo[2], _mm_unpackhi_epi32(lt, wh));
 
-    
+        __m128i c[4];
+        for (int k = 0; k < 4; ++k) {
+            const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&colors[i + k].r), zero), one);
+            c[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+        }
+        unsigned int rgba[4];
+        _mm_storeu_si128((__m128i*)rgba, _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3])));
+
+        for (int k = 0; k < 4; ++k) {
+            RectInstance* inst = &out[i + k];
+            memcpy(&inst->x, &geo[k], 8);
+            memcpy(inst->rgba, &rgba[k], 4);
+            inst->clip = clip;
+            inst->z = 0;
+            inst->shape = s_flatShape;
+        }
+    }
+#elif defined(SIMD_NEON)
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const int32x4_t zero = vdupq_n_s32(0);
+    for (; i + 4 <= n; i += 4) {
+        const int32x4_t xv = vld1q_s32(x + i), wv = vld1q_s32(w + i);
+        const int32x4_t yv = vld1q_s32(y + i), hv = vld1q_s32(h + i);
+        const int32x4_t L = vqaddq_s32(xv, vminq_s32(wv, zero)), R = vqaddq_s32(xv, vmaxq_s32(wv, zero));
+        const int32x4_t T = vqaddq_s32(yv, vminq_s32(hv, zero)), B = vqaddq_s32(yv, vmaxq_s32(hv, zero));
+        const int16x4_t L16 = vqmovn_s32(L), T16 = vqmovn_s32(T);
+        const int16x4_t W16 = vsub_s16(vqmovn_s32(R), L16), H16 = vsub_s16(vqmovn_s32(B), T16);
+        const int16x4x2_t lt = vzip_s16(L16, T16), wh = vzip_s16(W16, H16);
+        const int32x4x2_t geo = vzipq_s32(vreinterpretq_s32_s16(vcombine_s16(lt.val[0], lt.val[1])),
+                                          vreinterpretq_s32_s16(vcombine_s16(wh.val[0], wh.val[1])));
+        unsigned long long g[4];
+        vst1q_s32((int*)&g[0], geo.val[0]);
+        vst1q_s32((int*)&g[2], geo.val[1]);
+
+        uint16x4_t c[4];
+        for (int k = 0; k < 4; ++k) {
+            const float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32(&colors[i + k].r), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+            c[k] = vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(half, v, 255.0f)));
+        }
+        unsigned int rgba[4];
+        vst1q_u8((unsigned char*)rgba, vcombine_u8(vmovn_u16(vcombine_u16(c[0], c[1])), vmovn_u16(vcombine_u16(c[2], c[3]))));
+
+        for (int k = 0; k < 4; ++k) {
+            RectInstance* inst = &out[i + k];
+            memcpy(&inst->x, &g[k], 8);
+            memcpy(inst->rgba, &rgba[k], 4);
+            inst->clip = clip;
+            inst->z = 0;
+            inst->shape = s_flatShape;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        const long long L = (long long)x[i] + (w[i] < 0 ? w[i] : 0), R = (long long)x[i] + (w[i] > 0 ? w[i] : 0);
+        const long long T = (long long)y[i] + (h[i] < 0 ? h[i] : 0), B = (long long)y[i] + (h[i] > 0 ? h[i] : 0);
+        RectInstance* inst = &out[i];
+        inst->x = clamp_i16(L);
+        inst->y = clamp_i16(T);
+        inst->w = (unsigned short)(clamp_i16(R) - inst->x);
+        inst->h = (unsigned short)(clamp_i16(B) - inst->y);
+        const Color col = colors[i];
+        inst->rgba[0] = unorm8(col.r); inst->rgba[1] = unorm8(col.g);
+        inst->rgba[2] = unorm8(col.b); inst->rgba[3] = unorm8(col.a);
+        inst->clip = clip;
+        inst->z = 0;
+        inst->shape = s_flatShape;
+    }
 }
 
-void RendererShutdown(void) {
-    texbatch_shutdown();
-    rectbatch_shutdown();
+// Sprite batch (instanced quads sampling one GL_TEXTURE_2D_ARRAY)
+// Every loaded image is shelf-packed into a layer of a single texture array, so
+// sprites from any mix of images share one binding and draw in one call.
+// The array doubles its layer count when full; existing layers are copied over.
+#define TEX_LAYER_SIZE 2048
+#define TEX_LAYER_BYTES (4ll * TEX_LAYER_SIZE * TEX_LAYER_SIZE)
+#define TEX_PAD        2     // gap between packed images, never sampled
+
+static const char* s_spriteVS =
+"#version 330 core\n"
+CLIP_GLSL
+"uniform vec2 uViewport;\n"
+"uniform sampler2DArray uTex;\n"
+"in vec2 corner;\n"
+"in vec2 rect;\n"
+"in vec2 rectSize;\n"
+"in vec4 uvRect;\n"
+"in float layer;\n"
+"in vec4 inColor;\n"
+"in float clipId;\n"
+"in float inDepth;\n"
+"in float inFlags;\n"
+"out vec4 vColor;\n"
+"out vec2 vUV;\n"
+"flat out vec4 vUVClamp;\n"
+"flat out float vLayer;\n"
+"flat out float vPremul;\n"
+"void main(){\n"
+"  vec2 ts = vec2(textureSize(uTex, 0).xy);\n"
+"  vColor = inColor;\n"
+"  vLayer = layer;\n"
+"  vPremul = inFlags;\n"
+"  vUV = mix(uvRect.xy, uvRect.zw, corner) / ts;\n"
+"  vec4 lo = min(uvRect.xyzw, uvRect.zwxy), hi = max(uvRect.xyzw, uvRect.zwxy);\n"
+"  vUVClamp = vec4(lo.xy + 0.5, hi.xy - 0.5) / ts.xyxy;\n"
+"  vec2 p = rect + corner * rectSize;\n"
+"  apply_clip(p, clipId);\n"
+"  vec2 ndc = p * (2.0 / uViewport) - 1.0;\n"
+"  gl_Position = vec4(ndc.x, -ndc.y, inDepth * 2.0 - 1.0, 1.0);\n"
+"}\n";
+
+// Clamping to the image's own texel centers keeps linear filtering from
+// bleeding in neighbours packed into the same layer. Render textures hold
+// premultiplied color and are divided back out so one blend mode fits all.
+static const char* s_spriteFS =
+"#version 330 core\n"
+"uniform sampler2DArray uTex;\n"
+"in vec4 vColor;\n"
+"in vec2 vUV;\n"
+"flat in vec4 vUVClamp;\n"
+"flat in float vLayer;\n"
+"flat in float vPremul;\n"
+"out vec4 outColor;\n"
+"void main(){\n"
+"  vec4 t = texture(uTex, vec3(clamp(vUV, vUVClamp.xy, vUVClamp.zw), vLayer));\n"
+"  if (vPremul > 0.5) t.rgb /= max(t.a, 1.0 / 255.0);\n"
+"  outColor = t * vColor;\n"
+"}\n";
+
+#define SPRITE_PREMULTIPLIED 1
+
+// Instance layout: int16 pixel left/top, uint16 size, uint16 source rect in
+// layer pixels (u0,v0,u1,v1), RGBA8 tint, uint16 layer, uint16 clip id,
+// uint16 depth-pass z, uint16 flags (28 bytes)
+typedef struct SpriteInstance {
+    short x, y;
+    unsigned short w, h;
+    unsigned short uv[4];
+    unsigned char rgba[4];
+    unsigned short layer, clip;
+    unsigned short z, flags;
+} SpriteInstance;
+
+// Where a loaded image lives in the array. Render textures keep their
+// allocated region (capW x capH) so they can shrink and regrow in place.
+typedef struct TexImage {
+    unsigned short layer, x, y, w, h;
+    unsigned short capW, capH;
+    unsigned short flags;   // SPRITE_PREMULTIPLIED for render textures
+    unsigned short pending; // async upload steps still in flight; drawn once 0
+    unsigned short unloading; // released once pending reaches 0
+} TexImage;
+
+// Shelf packer state per layer: the open shelf's top, height and fill cursor,
+// and how many images sit on the layer, so an emptied layer starts over.
+typedef struct TexShelf {
+    int y, h, x;
+    int live;
+} TexShelf;
+
+// Space given back by unloaded images (padded footprints), reused before the
+// shelves are extended
+typedef struct TexRegion {
+    unsigned short layer, x, y, w, h;
+} TexRegion;
+
+typedef struct TexBatch {
+    StreamRing ring;
+    GLuint vao;
+    GLuint prog;
+    GLint  viewportLoc;
+
+    GLuint tex;          // GL_TEXTURE_2D_ARRAY, created on first load
+    int    layers;       // allocated layers
+    int    usedLayers;   // layers with at least one image
+    TexShelf* shelves;   // one per allocated layer
+    TexRegion* regions;  // free space on partly used layers
+    size_t regionCount, regionCap;
+
+    TexImage* images;    // indexed by Texture.id, slot 0 unused
+    size_t imageCount;
+    size_t imageCap;
+    unsigned int* freeIds; // unloaded image slots, reused first
+    size_t freeIdCount, freeIdCap;
+
+    size_t capSprites;
+    size_t countSprites;
+    SpriteInstance* instData;
+} TexBatch;
+
+static TexBatch s_texBatch = {0};
+
+static void bind_sprite_attribs(GLuint prog) {
+    glBindAttribLocation(prog, ATTR_CORNER, "corner");
+    glBindAttribLocation(prog, ATTR_RECT,   "rect");
+    glBindAttribLocation(prog, ATTR_RSIZE,  "rectSize");
+    glBindAttribLocation(prog, ATTR_UV,     "uvRect");
+    glBindAttribLocation(prog, ATTR_LAYER,  "layer");
+    glBindAttribLocation(prog, ATTR_ICOLOR, "inColor");
+    glBindAttribLocation(prog, ATTR_CLIP,   "clipId");
+    glBindAttribLocation(prog, ATTR_DEPTH,  "inDepth");
+    glBindAttribLocation(prog, ATTR_FLAGS,  "inFlags");
 }
 
-void Begin2D(int fbWidth, int fbHeight) {
-    s_fbW = fbWidth;
-    s_fbH = fbHeight;
-    glViewport(0, 0, fbWidth, fbHeight);
+static void sprite_instance_layout(size_t base) {
+    const GLsizei istride = (GLsizei)sizeof(SpriteInstance);
+    glVertexAttribPointer(ATTR_RECT,   2, GL_SHORT,          GL_FALSE, istride, (void*)(base + offsetof(SpriteInstance, x)));
+    glVertexAttribPointer(ATTR_RSIZE,  2, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(SpriteInstance, w)));
+    glVertexAttribPointer(ATTR_UV,     4, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(SpriteInstance, uv)));
+    glVertexAttribPointer(ATTR_LAYER,  1, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(SpriteInstance, layer)));
+    glVertexAttribPointer(ATTR_ICOLOR, 4, GL_UNSIGNED_BYTE,  GL_TRUE,  istride, (void*)(base + offsetof(SpriteInstance, rgba)));
+    glVertexAttribPointer(ATTR_CLIP,   1, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(SpriteInstance, clip)));
+    glVertexAttribPointer(ATTR_DEPTH,  1, GL_UNSIGNED_SHORT, GL_TRUE,  istride, (void*)(base + offsetof(SpriteInstance, z)));
+    glVertexAttribPointer(ATTR_FLAGS,  1, GL_UNSIGNED_SHORT, GL_FALSE, istride, (void*)(base + offsetof(SpriteInstance, flags)));
+}
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+static void texbatch_init(size_t capSprites) {
+    s_texBatch.capSprites   = capSprites ? capSprites : 2048;
+    s_texBatch.countSprites = 0;
+    s_texBatch.instData = (SpriteInstance*)MemAlloc(MEM_RENDERER, 
+        s_texBatch.capSprites * sizeof(SpriteInstance));
+
+    glGenVertexArrays(1, &s_texBatch.vao);
+    gl_bind_vao(s_texBatch.vao);
+    unit_quad_bind();
+
+    ring_init(&s_texBatch.ring, RING_REGION_BYTES);
+    const GLuint attrs[] = { ATTR_RECT, ATTR_RSIZE, ATTR_UV, ATTR_LAYER, ATTR_ICOLOR, ATTR_CLIP, ATTR_DEPTH, ATTR_FLAGS };
+    for (size_t i = 0; i < sizeof attrs / sizeof attrs[0]; ++i) {
+        glEnableVertexAttribArray(attrs[i]);
+        glVertexAttribDivisor(attrs[i], 1);
+    }
+    sprite_instance_layout(0);
+
+    GLuint vs = compile_shader(GL_VERTEX_SHADER,   s_spriteVS);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, s_spriteFS);
+    s_texBatch.prog = link_program(vs, fs, bind_sprite_attribs);
+    s_texBatch.viewportLoc = glGetUniformLocation(s_texBatch.prog, "uViewport");
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    gl_use_program(s_texBatch.prog);
+    glUniform1i(glGetUniformLocation(s_texBatch.prog, "uTex"), 0);
+    glUniform1i(glGetUniformLocation(s_texBatch.prog, "uClips"), 1);
 }
 
+static void texbatch_shutdown(void) {
+    MemFree(s_texBatch.instData); s_texBatch.instData = NULL;
+    MemFree(s_texBatch.shelves);  s_texBatch.shelves = NULL;
+    MemFree(s_texBatch.images);   s_texBatch.images = NULL;
+    MemFree(s_texBatch.regions);  s_texBatch.regions = NULL;
+    MemFree(s_texBatch.freeIds);  s_texBatch.freeIds = NULL;
+    if (s_texBatch.tex) MemTrackGpu(MEM_GPU_TEXTURES, -(long long)s_texBatch.layers * TEX_LAYER_BYTES);
+    s_texBatch.capSprites = s_texBatch.countSprites = 0;
+    s_texBatch.imageCount = s_texBatch.imageCap = 0;
+    s_texBatch.regionCount = s_texBatch.regionCap = 0;
+    s_texBatch.freeIdCount = s_texBatch.freeIdCap = 0;
+    s_texBatch.layers = s_texBatch.usedLayers = 0;
 
-void End2D(void) {
-    // If you tend to draw rects then sprites, this order preserves that pattern
-    rectbatch_flush();
-    texbatch_flush();
+    ring_shutdown(&s_texBatch.ring);
+    gl_delete_texture(&s_texBatch.tex);
+    gl_delete_vao(&s_texBatch.vao);
+    gl_delete_program(&s_texBatch.prog);
 }
 
-void Flush2D(void) {
-    rectbatch_flush();
-    texbatch_flush();
+// (Re)allocate the array with newLayers layers, copying the used ones across.
+static bool texarray_resize(int newLayers) {
+    const long long delta = (long long)(newLayers - s_texBatch.layers) * TEX_LAYER_BYTES;
+    if (!MemTrackGpu(MEM_GPU_TEXTURES, delta)) {
+        fprintf(stderr, "Texture array growth to %d layers exceeds the GPU texture budget.\n", newLayers);
+        return false;
+    }
+    TexShelf* shelves = (TexShelf*)MemRealloc(MEM_TEXTURES, s_texBatch.shelves, (size_t)newLayers * sizeof(TexShelf));
+    if (!shelves) {
+        fprintf(stderr, "Out of memory growing texture array.\n");
+        MemTrackGpu(MEM_GPU_TEXTURES, -delta);
+        return false;
+    }
+    memset(shelves + s_texBatch.layers, 0, (size_t)(newLayers - s_texBatch.layers) * sizeof(TexShelf));
+    s_texBatch.shelves = shelves;
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    gl_bind_texture(0, GLS_TEX_2D_ARRAY, tex);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, TEX_LAYER_SIZE, TEX_LAYER_SIZE, newLayers,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if (s_texBatch.tex && s_texBatch.usedLayers > 0) {
+        GLint prevRead = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevRead);
+        GLuint fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        for (int l = 0; l < s_texBatch.usedLayers; ++l) {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, s_texBatch.tex, 0, l);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, l, 0, 0, TEX_LAYER_SIZE, TEX_LAYER_SIZE);
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)prevRead);
+        glDeleteFramebuffers(1, &fbo);
+    }
+    gl_delete_texture(&s_texBatch.tex);
+
+    s_texBatch.tex = tex;
+    s_texBatch.layers = newLayers;
+    return true;
 }
 
-void DrawRectangle(int x, int y, int w, int h, Color c) {
-    rectbatch_push(x, y, w, h, c.r, c.g, c.b, c.a);
-}
\ No newline at end of file
+static bool shelf_place(TexShelf* sh, int w, int h, int* outX, int* outY) {
+    const int pw = w + TEX_PAD, ph = h + TEX_PAD;
+    if (sh->h > 0 && ph <= sh->h && sh->x + pw <= TEX_LAYER_SIZE) {
+        *outX = sh->x; *outY = sh->y;
+        sh->x += pw;
+        return true;
+    }
+    if (sh->y + sh->h + ph <= TEX_LAYER_SIZE) {
+        sh->y += sh->h;
+        sh->h = ph;
+        sh->x = pw;
+        *outX = 0; *outY = sh->y;
+        return true;
+    }
+    return false;
+}
+
+// Adds free space, merging it with a neighbour it lines up with exactly.
+// Slivers no image fits in are dropped, as is space the list has no room for.
+static void texregion_add(TexRegion r) {
+    for (size_t i = 0; i < s_texBatch.regionCount; ++i) {
+        const TexRegion o = s_texBatch.regions[i];
+        if (o.layer != r.layer) continue;
+        const bool row = o.y == r.y && o.h == r.h && (o.x + o.w == r.x || r.x + r.w == o.x);
+        const bool col = o.x == r.x && o.w == r.w && (o.y + o.h == r.y || r.y + r.h == o.y);
+        if (!row && !col) continue;
+        if (row) { r.x = o.x < r.x ? o.x : r.x; r.w = (unsigned short)(r.w + o.w); }
+        else     { r.y = o.y < r.y ? o.y : r.y; r.h = (unsigned short)(r.h + o.h); }
+        s_texBatch.regions[i] = s_texBatch.regions[--s_texBatch.regionCount];
+        i = (size_t)-1; // the grown region may now line up with another
+    }
+    if (r.w <= TEX_PAD || r.h <= TEX_PAD) return;
+    if (s_texBatch.regionCount == s_texBatch.regionCap) {
+        const size_t newCap = s_texBatch.regionCap ? s_texBatch.regionCap * 2 : 64;
+        TexRegion* regions = (TexRegion*)MemRealloc(MEM_TEXTURES, s_texBatch.regions, newCap * sizeof *regions);
+        if (!regions) return;
+        s_texBatch.regions = regions;
+        s_texBatch.regionCap = newCap;
+    }
+    s_texBatch.regions[s_texBatch.regionCount++] = r;
+}
+
+// Takes the tightest free region holding pw*ph, splitting off what is left:
+// the strip beside the image and the full-width strip below it.
+static bool texregion_take(int pw, int ph, int* layer, int* x, int* y) {
+    size_t best = s_texBatch.regionCount;
+    int bestArea = 0;
+    for (size_t i = 0; i < s_texBatch.regionCount; ++i) {
+        const TexRegion* r = &s_texBatch.regions[i];
+        const int area = r->w * r->h;
+        if (r->w < pw || r->h < ph || (best < s_texBatch.regionCount && area >= bestArea)) continue;
+        best = i;
+        bestArea = area;
+    }
+    if (best == s_texBatch.regionCount) return false;
+
+    const TexRegion r = s_texBatch.regions[best];
+    s_texBatch.regions[best] = s_texBatch.regions[--s_texBatch.regionCount];
+    *layer = r.layer; *x = r.x; *y = r.y;
+    texregion_add((TexRegion){ r.layer, (unsigned short)(r.x + pw), r.y, (unsigned short)(r.w - pw), (unsigned short)ph });
+    texregion_add((TexRegion){ r.layer, r.x, (unsigned short)(r.y + ph), r.w, (unsigned short)(r.h - ph) });
+    return true;
+}
+
+// Finds room for a w*h image: freed space first, then the layers' shelves,
+// then a new layer.
+static bool texarray_alloc(int w, int h, TexImage* out) {
+    int l = 0, x = 0, y = 0;
+    bool placed = texregion_take(w + TEX_PAD, h + TEX_PAD, &l, &x, &y);
+    for (int i = 0; !placed && i < s_texBatch.usedLayers; ++i) {
+        placed = shelf_place(&s_texBatch.shelves[i], w, h, &x, &y);
+        l = i;
+    }
+
+    if (!placed) {
+        if (s_texBatch.usedLayers == s_texBatch.layers) {
+            GLint maxLayers = 256;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+            if (s_texBatch.layers >= maxLayers) {
+                fprintf(stderr, "Texture array full (%d layers).\n", s_texBatch.layers);
+                return false;
+            }
+            int newLayers = s_texBatch.layers ? s_texBatch.layers * 2 : 1;
+            if (newLayers > maxLayers) newLayers = maxLayers;
+            if (!texarray_resize(newLayers)) return false;
+        }
+        l = s_texBatch.usedLayers++;
+        shelf_place(&s_texBatch.shelves[l], w, h, &x, &y);
+    }
+
+    s_texBatch.shelves[l].live++;
+    *out = (TexImage){ (unsigned short)l, (unsigned short)x, (unsigned short)y,
+                       (unsigned short)w, (unsigned short)h, (unsigned short)w, (unsigned short)h, 0, 0, 0 };
+    return true;
+}
+
+// Gives an image's region back. A layer left empty drops its free regions
+// and restarts its shelves, which undoes any fragmentation on it.
+static void texarray_free(const TexImage* img) {
+    TexShelf* sh = &s_texBatch.shelves[img->layer];
+    if (--sh->live > 0) {
+        texregion_add((TexRegion){ img->layer, img->x, img->y,
+                                   (unsigned short)(img->capW + TEX_PAD), (unsigned short)(img->capH + TEX_PAD) });
+        return;
+    }
+    *sh = (TexShelf){0};
+    for (size_t i = 0; i < s_texBatch.regionCount;) {
+        if (s_texBatch.regions[i].layer == img->layer) s_texBatch.regions[i] = s_texBatch.regions[--s_texBatch.regionCount];
+        else ++i;
+    }
+}
+
+static void texbatch_maybe_grow(size_t requiredSprites) {
+    if (requiredSprites <= s_texBatch.capSprites) return;
+
+    size_t newCap = s_texBatch.capSprites;
+    while (newCap < requiredSprites) newCap <<= 1;
+
+    SpriteInstance* newI = (SpriteInstance*)MemRealloc(MEM_RENDERER, 
+        s_texBatch.instData, newCap * sizeof(SpriteInstance));
+    if (!newI) {
+        fprintf(stderr, "Out of memory growing sprite batch.\n");
+        return;
+    }
+    s_texBatch.instData = newI;
+    s_texBatch.capSprites = newCap;
+}
+
+static void texbatch_flush(void) {
+    if (s_texBatch.countSprites == 0) return;
+
+    const size_t iBytes = s_texBatch.countSprites * sizeof(SpriteInstance);
+
+    gl_use_program(s_texBatch.prog);
+    gl_bind_vao(s_texBatch.vao);
+    gl_bind_texture(0, GLS_TEX_2D_ARRAY, s_texBatch.tex);
+
+    const size_t base = ring_write(&s_texBatch.ring, s_texBatch.instData, iBytes);
+    sprite_instance_layout(base);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)s_texBatch.countSprites);
+
+    s_texBatch.countSprites = 0;
+}
+
+// Negative w/h mirror the sprite, mirroring the source rect to match.
+static inline void texbatch_push(const TexImage* img, int x, int y, int w, int h,
+                                 float r, float g, float b, float a, unsigned short clip,
+                                 unsigned short z) {
+    if (w == 0 || h == 0 || s_fbW <= 0 || s_fbH <= 0) return;
+
+    unsigned short u0 = img->x, u1 = (unsigned short)(img->x + img->w);
+    unsigned short v0 = img->y, v1 = (unsigned short)(img->y + img->h);
+    if (w < 0) { x += w; w = -w; unsigned short t = u0; u0 = u1; u1 = t; }
+    if (h < 0) { y += h; h = -h; unsigned short t = v0; v0 = v1; v1 = t; }
+
+    const size_t need = s_texBatch.countSprites + 1;
+    if (need > s_texBatch.capSprites) {
+        texbatch_maybe_grow(need);
+        if (need > s_texBatch.capSprites) return; // OOM guard
+    }
+
+    const short L = clamp_i16(x), R = clamp_i16((long)x + w);
+    const short T = clamp_i16(y), B = clamp_i16((long)y + h);
+
+    SpriteInstance* inst = s_texBatch.instData + s_texBatch.countSprites;
+    inst->x = L; inst->y = T;
+    inst->w = (unsigned short)(R - L); inst->h = (unsigned short)(B - T);
+    inst->uv[0] = u0; inst->uv[1] = v0; inst->uv[2] = u1; inst->uv[3] = v1;
+    inst->rgba[0] = unorm8(r); inst->rgba[1] = unorm8(g);
+    inst->rgba[2] = unorm8(b); inst->rgba[3] = unorm8(a);
+    inst->layer = img->layer;
+    inst->clip = clip;
+    inst->z = z;
+    inst->flags = img->flags;
+
+    s_texBatch.countSprites += 1;
+}
+
+// NULL for invalid handles and, on GL, for images still uploading
+static const TexImage* texbatch_image(Texture t) {
+    if (t.id == 0 || t.id >= s_texBatch.imageCount) return NULL;
+    const TexImage* img = &s_texBatch.images[t.id];
+    if (!img->capW || img->unloading) return NULL;
+    return img->pending && s_backend == RENDER_BACKEND_GL ? NULL : img;
+}
+
+static void texture_release(unsigned int id);
+
+// Async texture uploads
+// LoadTextureFromPixelsAsync reserves the image's array region at once and
+// stages its rows into a pool of pixel unpack buffers, issuing
+// glTexSubImage3D from buffer offsets so the copy into the texture happens on
+// the GPU's schedule. End2D fences the buffer filled that frame; a buffer is
+// reused, and the images it carried count as resident, once its fence has
+// passed, normally a frame or two later. Rows that find no free buffer wait
+// in a CPU-side queue that End2D drains in order.
+#define UPLOAD_PBOS      4
+#define UPLOAD_PBO_BYTES (4u << 20)
+#define UPLOAD_ALIGN     16
+
+typedef struct UploadPbo {
+    GLuint buf;
+    size_t head;            // bytes staged; 0 with no fence = free
+    GLsync fence;           // closed: GL may still be reading
+    unsigned int* ids;      // image per staged chunk
+    size_t idCount, idCap;
+} UploadPbo;
+
+typedef struct UploadJob {
+    unsigned int id;
+    int row;                // next row to stage
+    int firstRow;           // row held at pixels[0]
+    unsigned char* pixels;  // CPU copy of rows firstRow..h-1
+} UploadJob;
+
+typedef struct UploadQueue {
+    UploadPbo pbo[UPLOAD_PBOS];
+    int open;               // PBO being filled this frame, -1 none
+    UploadJob* jobs;        // FIFO of images waiting for staging space
+    size_t jobCount, jobCap;
+} UploadQueue;
+
+static UploadQueue s_upload = { .open = -1 };
+
+// Marks images resident for every closed PBO whose fence has passed.
+static void upload_retire(void) {
+    for (int i = 0; i < UPLOAD_PBOS; ++i) {
+        UploadPbo* p = &s_upload.pbo[i];
+        if (!p->fence || glClientWaitSync(p->fence, 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+        glDeleteSync(p->fence);
+        p->fence = NULL;
+        for (size_t k = 0; k < p->idCount; ++k) {
+            TexImage* img = &s_texBatch.images[p->ids[k]];
+            if (--img->pending == 0 && img->unloading) texture_release(p->ids[k]);
+        }
+        p->idCount = 0;
+        p->head = 0;
+    }
+}
+
+static void upload_close(void) {
+    if (s_upload.open < 0) return;
+    UploadPbo* p = &s_upload.pbo[s_upload.open];
+    p->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s_upload.open = -1;
+}
+
+// A PBO with room for at least one row of rowBytes, or NULL
+static UploadPbo* upload_space(size_t rowBytes) {
+    if (s_upload.open >= 0) {
+        UploadPbo* p = &s_upload.pbo[s_upload.open];
+        if (p->head + rowBytes <= UPLOAD_PBO_BYTES) return p;
+        upload_close();
+    }
+    for (int i = 0; i < UPLOAD_PBOS; ++i) {
+        UploadPbo* p = &s_upload.pbo[i];
+        if (p->fence || p->head) continue;
+        if (!p->buf) {
+            glGenBuffers(1, &p->buf);
+            gl_bind_buffer(GLS_PIXEL_UNPACK_BUFFER, p->buf);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, UPLOAD_PBO_BYTES, NULL, GL_STREAM_DRAW);
+            MemTrackGpu(MEM_GPU_BUFFERS, UPLOAD_PBO_BYTES);
+        }
+        s_upload.open = i;
+        return p;
+    }
+    return NULL;
+}
+
+// Stages rows *row.. of image id from src (which starts at firstRow) while
+// buffer space lasts; returns true once every row is staged.
+static bool upload_stage(unsigned int id, const unsigned char* src, int firstRow, int* row) {
+    const TexImage img = s_texBatch.images[id];
+    const size_t rowBytes = (size_t)img.w * 4;
+    bool done = *row >= img.h;
+    while (!done) {
+        UploadPbo* p = upload_space(rowBytes);
+        if (!p) break;
+        if (p->idCount == p->idCap) {
+            const size_t newCap = p->idCap ? p->idCap * 2 : 64;
+            unsigned int* ids = (unsigned int*)MemRealloc(MEM_TEXTURES, p->ids, newCap * sizeof *ids);
+            if (!ids) {
+                fprintf(stderr, "Out of memory queueing texture upload.\n");
+                break;
+            }
+            p->ids = ids;
+            p->idCap = newCap;
+        }
+
+        int rows = (int)((UPLOAD_PBO_BYTES - p->head) / rowBytes);
+        if (rows > img.h - *row) rows = img.h - *row;
+        const size_t bytes = (size_t)rows * rowBytes;
+        gl_bind_buffer(GLS_PIXEL_UNPACK_BUFFER, p->buf);
+        void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, (GLintptr)p->head, (GLsizeiptr)bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        const unsigned char* rowsSrc = src + (size_t)(*row - firstRow) * rowBytes;
+        if (dst) {
+            memcpy(dst, rowsSrc, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        } else {
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, (GLintptr)p->head, (GLsizeiptr)bytes, rowsSrc);
+        }
+        gl_bind_texture(0, GLS_TEX_2D_ARRAY, s_texBatch.tex);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, img.x, img.y + *row, img.layer, img.w, rows, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, (const void*)p->head);
+
+        p->ids[p->idCount++] = id;
+        s_texBatch.images[id].pending++;
+        p->head = (p->head + bytes + (UPLOAD_ALIGN - 1)) & ~(size_t)(UPLOAD_ALIGN - 1);
+        *row += rows;
+        done = *row >= img.h;
+    }
+    // Client-memory uploads elsewhere need the unpack binding clear
+    gl_bind_buffer(GLS_PIXEL_UNPACK_BUFFER, 0);
+    return done;
+}
+
+// Starts uploading image id; its pending count holds one extra step until
+// every row is staged.
+static void upload_enqueue(unsigned int id, const unsigned char* rgba) {
+    const TexImage* img = &s_texBatch.images[id];
+    const int h = img->h;
+    const size_t rowBytes = (size_t)img->w * 4;
+    s_texBatch.images[id].pending = 1;
+
+    int row = 0;
+    if (s_upload.jobCount == 0 && upload_stage(id, rgba, 0, &row)) {
+        s_texBatch.images[id].pending--;
+        return;
+    }
+
+    if (s_upload.jobCount == s_upload.jobCap) {
+        const size_t newCap = s_upload.jobCap ? s_upload.jobCap * 2 : 16;
+        UploadJob* jobs = (UploadJob*)MemRealloc(MEM_TEXTURES, s_upload.jobs, newCap * sizeof *jobs);
+        if (!jobs) {
+            fprintf(stderr, "Out of memory queueing texture upload.\n");
+            return; // stays pending: never drawn rather than drawn wrong
+        }
+        s_upload.jobs = jobs;
+        s_upload.jobCap = newCap;
+    }
+    unsigned char* copy = (unsigned char*)MemAlloc(MEM_TEXTURES, (size_t)(h - row) * rowBytes);
+    if (!copy) {
+        fprintf(stderr, "Out of memory queueing texture upload.\n");
+        return;
+    }
+    memcpy(copy, rgba + (size_t)row * rowBytes, (size_t)(h - row) * rowBytes);
+    s_upload.jobs[s_upload.jobCount++] = (UploadJob){ id, row, row, copy };
+}
+
+// Per frame: stage queued rows in order, then fence this frame's buffer.
+static void upload_pump(void) {
+    size_t done = 0;
+    while (done < s_upload.jobCount) {
+        UploadJob* j = &s_upload.jobs[done];
+        if (!upload_stage(j->id, j->pixels, j->firstRow, &j->row)) break;
+        s_texBatch.images[j->id].pending--;
+        MemFree(j->pixels);
+        done++;
+    }
+    if (done) {
+        memmove(s_upload.jobs, s_upload.jobs + done, (s_upload.jobCount - done) * sizeof *s_upload.jobs);
+        s_upload.jobCount -= done;
+    }
+    upload_close();
+}
+
+static void upload_shutdown(void) {
+    for (int i = 0; i < UPLOAD_PBOS; ++i) {
+        UploadPbo* p = &s_upload.pbo[i];
+        if (p->fence) glDeleteSync(p->fence);
+        if (p->buf) MemTrackGpu(MEM_GPU_BUFFERS, -(long long)UPLOAD_PBO_BYTES);
+        gl_delete_buffer(&p->buf);
+        MemFree(p->ids);
+    }
+    for (size_t i = 0; i < s_upload.jobCount; ++i) MemFree(s_upload.jobs[i].pixels);
+    MemFree(s_upload.jobs);
+    s_upload = (UploadQueue){ .open = -1 };
+}
+
+// Frame statistics
+// Each batch flush is bracketed by CPU timestamps and a GL_TIME_ELAPSED query.
+// A frame's queries are read back TIMER_FRAMES frames later, when the GPU has
+// normally finished them, so gpuMs trails the CPU figures by that much.
+#define TIMER_FRAMES 3
+
+typedef struct TimerSlot {
+    GLuint* queries;        // one per timed flush, grown on demand
+    unsigned int used, cap;
+} TimerSlot;
+
+typedef struct FrameTimer {
+    TimerSlot slots[TIMER_FRAMES];
+    int    slot;            // slot recording the current frame
+    double frameStart;      // GetTime() at Begin2D
+    unsigned long long glIssued, glSkipped; // state cache counters at Begin2D
+    double gpuMs;           // most recently resolved frame
+    FrameStats cur;         // accumulating since Begin2D
+    FrameStats last;        // published by End2D
+} FrameTimer;
+
+static FrameTimer s_timer = {0};
+
+static void timer_shutdown(void) {
+    for (int i = 0; i < TIMER_FRAMES; ++i) {
+        TimerSlot* ts = &s_timer.slots[i];
+        if (ts->cap) glDeleteQueries((GLsizei)ts->cap, ts->queries);
+        MemFree(ts->queries);
+    }
+    memset(&s_timer, 0, sizeof s_timer);
+}
+
+// Starts timing one flush; false (flush untimed) if out of query objects
+static bool timer_begin(void) {
+    TimerSlot* ts = &s_timer.slots[s_timer.slot];
+    if (ts->used == ts->cap) {
+        const unsigned int newCap = ts->cap ? ts->cap * 2 : 16;
+        GLuint* q = (GLuint*)MemRealloc(MEM_RENDERER, ts->queries, newCap * sizeof(GLuint));
+        if (!q) return false;
+        glGenQueries((GLsizei)(newCap - ts->cap), q + ts->cap);
+        ts->queries = q;
+        ts->cap = newCap;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, ts->queries[ts->used++]);
+    return true;
+}
+
+// Sums a recorded frame's queries if the GPU is done with them (results that
+// are still pending are dropped rather than waited on) and empties the slot.
+static void timer_resolve(TimerSlot* ts) {
+    if (ts->used == 0) { s_timer.gpuMs = 0.0; return; }
+    GLint ready = 0;
+    glGetQueryObjectiv(ts->queries[ts->used - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (ready) {
+        GLuint64 total = 0;
+        for (unsigned int i = 0; i < ts->used; ++i) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(ts->queries[i], GL_QUERY_RESULT, &ns);
+            total += ns;
+        }
+        s_timer.gpuMs = (double)total * 1e-6;
+    }
+    ts->used = 0;
+}
+
+// Draw command queue
+// DrawRectangle/DrawTexture record a command plus a 64-bit sort key instead of
+// pushing straight into a batch. End2D radix-sorts the keys and replays them,
+// flushing a batch only when the pipeline or texture binding changes.
+//
+// Key layout (msb -> lsb):
+//   [63:56] layer      SetDrawLayer; higher layers draw on top
+//   [55:40] depth      one above the deepest earlier command of another
+//                      pipeline that it overlaps (same depth for the same
+//                      pipeline), so grouping by pipeline below never
+//                      reorders overlapping draws
+//   [39:36] pipeline
+//   [35:24] texture    texture-array binding for the pipeline
+//   [23: 0] sequence   submission order; doubles as the command index
+#define KEY_LAYER_SHIFT 56
+#define KEY_DEPTH_SHIFT 40
+#define KEY_PIPE_SHIFT  36
+#define KEY_TEX_SHIFT   24
+#define KEY_DEPTH_MAX   0xFFFFu
+#define KEY_SEQ_MASK    0xFFFFFFu
+
+// Overlap is tracked on a grid of framebuffer cells: each cell keeps, per
+// pipeline, the deepest depth drawn into it and the cell-local bounds of
+// everything drawn there. Bounds are a union, so the test is conservative:
+// it can only cost batching, never order. The grid spans all layers until
+// the queue is emitted, for the same reason.
+#define QUEUE_CELL_SHIFT 4
+#define QUEUE_CELL_SIZE  (1 << QUEUE_CELL_SHIFT)
+
+typedef struct QueueCell {
+    unsigned short depth;          // deepest depth + 1, 0 = empty
+    unsigned char  x0, y0, x1, y1; // cell-local bounds, [x0,x1) x [y0,y1)
+} QueueCell;
+
+typedef enum Pipeline {
+    PIPE_RECT = 0,
+    PIPE_SPRITE,
+    PIPE_COUNT
+} Pipeline;
+
+typedef struct DrawCmd {
+    int x, y, w, h;
+    Color color;
+    unsigned int tex;    // Texture id (sprites)
+    unsigned short clip; // clip table id
+    RectShape shape;     // rects only
+} DrawCmd;
+
+typedef struct DrawQueue {
+    DrawCmd*            cmds;
+    unsigned long long* keys;
+    unsigned long long* scratch;   // radix sort ping-pong buffer
+    size_t cap;
+    size_t count;
+
+    unsigned int    layer;
+    QueueCell* grid;               // gridW * gridH cells * PIPE_COUNT
+    int    gridW, gridH;
+    size_t gridCap;
+} DrawQueue;
+
+static DrawQueue s_queue = {0};
+
+static void queue_init(size_t cap) {
+    s_queue.cap     = cap ? cap : 4096;
+    s_queue.count   = 0;
+    s_queue.cmds    = (DrawCmd*)MemAlloc(MEM_RENDERER, s_queue.cap * sizeof(DrawCmd));
+    s_queue.keys    = (unsigned long long*)MemAlloc(MEM_RENDERER, s_queue.cap * sizeof(unsigned long long));
+    s_queue.scratch = (unsigned long long*)MemAlloc(MEM_RENDERER, s_queue.cap * sizeof(unsigned long long));
+}
+
+static void queue_shutdown(void) {
+    MemFree(s_queue.cmds);    s_queue.cmds = NULL;
+    MemFree(s_queue.keys);    s_queue.keys = NULL;
+    MemFree(s_queue.scratch); s_queue.scratch = NULL;
+    MemFree(s_queue.grid);    s_queue.grid = NULL;
+    s_queue.cap = s_queue.count = 0;
+    s_queue.gridW = s_queue.gridH = 0;
+    s_queue.gridCap = 0;
+}
+
+static void queue_clear_grid(void) {
+    if (s_queue.grid)
+        memset(s_queue.grid, 0, (size_t)s_queue.gridW * s_queue.gridH * PIPE_COUNT * sizeof(QueueCell));
+}
+
+static void queue_resize_grid(int fbW, int fbH) {
+    const int gw = (fbW + QUEUE_CELL_SIZE - 1) >> QUEUE_CELL_SHIFT;
+    const int gh = (fbH + QUEUE_CELL_SIZE - 1) >> QUEUE_CELL_SHIFT;
+    const size_t need = (size_t)gw * gh * PIPE_COUNT;
+    if (need > s_queue.gridCap) {
+        QueueCell* g = (QueueCell*)MemRealloc(MEM_RENDERER, s_queue.grid, need * sizeof(QueueCell));
+        if (!g) {
+            fprintf(stderr, "Out of memory sizing draw queue grid.\n");
+            return;
+        }
+        s_queue.grid = g;
+        s_queue.gridCap = need;
+    }
+    s_queue.gridW = gw;
+    s_queue.gridH = gh;
+    queue_clear_grid();
+}
+
+static bool queue_grow(void) {
+    const size_t newCap = s_queue.cap * 2;
+    DrawCmd* c = (DrawCmd*)MemRealloc(MEM_RENDERER, s_queue.cmds, newCap * sizeof(DrawCmd));
+    if (!c) return false;
+    s_queue.cmds = c;
+    unsigned long long* k = (unsigned long long*)MemRealloc(MEM_RENDERER, s_queue.keys, newCap * sizeof(unsigned long long));
+    if (!k) return false;
+    s_queue.keys = k;
+    unsigned long long* t = (unsigned long long*)MemRealloc(MEM_RENDERER, s_queue.scratch, newCap * sizeof(unsigned long long));
+    if (!t) return false;
+    s_queue.scratch = t;
+    s_queue.cap = newCap;
+    return true;
+}
+
+// LSD radix sort, 8 bits per pass. Passes where every key shares the same
+// digit (typically layer, depth and texture) are skipped.
+static void radix_sort_keys(unsigned long long* keys, unsigned long long* tmp, size_t n) {
+    unsigned long long* src = keys;
+    unsigned long long* dst = tmp;
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t hist[256] = {0};
+        for (size_t i = 0; i < n; ++i) hist[(src[i] >> shift) & 0xFF]++;
+        if (hist[(src[0] >> shift) & 0xFF] == n) continue;
+
+        size_t sum = 0;
+        for (int b = 0; b < 256; ++b) { size_t c = hist[b]; hist[b] = sum; sum += c; }
+        for (size_t i = 0; i < n; ++i) dst[hist[(src[i] >> shift) & 0xFF]++] = src[i];
+
+        unsigned long long* t = src; src = dst; dst = t;
+    }
+    if (src != keys) memcpy(keys, src, n * sizeof *keys);
+}
+
+static void pipeline_flush(int pipe) {
+    size_t count = 0;
+    switch (pipe) {
+        case PIPE_RECT:   count = s_rectBatch.countQuads;  break;
+        case PIPE_SPRITE: count = s_texBatch.countSprites; break;
+        default: break;
+    }
+    if (count == 0) return;
+
+    PROFILE_BEGIN(pipe == PIPE_RECT ? "flush rects" : "flush sprites");
+    const double t0 = GetTime();
+    const unsigned long long bytes0 = s_ringStats.bytesStreamed;
+    const bool timed = timer_begin();
+    if (pipe == PIPE_RECT) rectbatch_flush();
+    else                   texbatch_flush();
+    if (timed) glEndQuery(GL_TIME_ELAPSED);
+    PROFILE_END();
+
+    FrameStats* f = &s_timer.cur;
+    f->flushMs += (GetTime() - t0) * 1e3;
+    f->bytesUploaded += s_ringStats.bytesStreamed - bytes0;
+    f->quads += (unsigned int)count;
+    f->drawCalls++;
+}
+
+// Pushes one sorted command into its batch, flushing the open batch first
+// when the pipeline or texture binding changes.
+static void queue_replay(unsigned long long key, unsigned short z, int* prevPipe, unsigned int* prevTex) {
+    const int pipe = (int)((key >> KEY_PIPE_SHIFT) & 0xF);
+    const unsigned int tex = (unsigned int)((key >> KEY_TEX_SHIFT) & 0xFFF);
+    const DrawCmd* c = &s_queue.cmds[key & KEY_SEQ_MASK];
+
+    if (pipe != *prevPipe || tex != *prevTex) {
+        pipeline_flush(*prevPipe);
+        *prevPipe = pipe;
+        *prevTex = tex;
+    }
+
+    if (pipe == PIPE_RECT) {
+        rectbatch_push(c->x, c->y, c->w, c->h, c->color.r, c->color.g, c->color.b, c->color.a,
+                       c->clip, z, c->shape);
+    } else {
+        const TexImage* img = &s_texBatch.images[c->tex];
+        texbatch_push(img, c->x, c->y, c->w, c->h, c->color.r, c->color.g, c->color.b, c->color.a,
+                      c->clip, z);
+    }
+}
+
+// Opaque depth pass
+// Flat rects with alpha 1 cover every pixel they touch, so they can be drawn
+// front to back with depth writes and let early-Z reject whatever they hide.
+// Everything else (sprites, translucent, rounded or bordered rects) follows
+// back to front, blended and depth tested against them. A command's z comes
+// from its sorted position: later draws get smaller z and win GL_LESS.
+#define DEPTH_PASS_MAX 0xFFFEu // commands per depth clear; z stays below the 1.0 clear
+
+typedef struct DepthPass {
+    bool enabled;   // SetOpaqueDepthPass
+    bool available; // the bound framebuffer has a depth buffer (checked in Begin2D)
+} DepthPass;
+
+static DepthPass s_depthPass = {0};
+
+static bool framebuffer_has_depth(void) {
+    GLint fbo = 0, type = GL_NONE, bits = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+    const GLenum att = fbo ? GL_DEPTH_ATTACHMENT : GL_DEPTH;
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, att, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+    if (type == GL_NONE) return false;
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, att, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &bits);
+    return bits > 0;
+}
+
+static inline bool key_opaque(unsigned long long key) {
+    if (((key >> KEY_PIPE_SHIFT) & 0xF) != PIPE_RECT) return false;
+    const DrawCmd* c = &s_queue.cmds[key & KEY_SEQ_MASK];
+    return c->color.a >= 1.0f && memcmp(&c->shape, &s_flatShape, sizeof(RectShape)) == 0;
+}
+
+// Replays n <= DEPTH_PASS_MAX sorted commands in the two passes. Every call
+// starts from a cleared depth buffer; it draws entirely over earlier calls.
+static void queue_emit_depth(const unsigned long long* keys, size_t n) {
+    int prevPipe = -1;
+    unsigned int prevTex = 0;
+
+    gl_depth_mask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    gl_enable(GL_DEPTH_TEST, true);
+    gl_depth_func(GL_LESS);
+
+    gl_enable(GL_BLEND, false);
+    for (size_t i = n; i-- > 0;) {
+        if (key_opaque(keys[i])) queue_replay(keys[i], (unsigned short)(DEPTH_PASS_MAX - i), &prevPipe, &prevTex);
+    }
+    pipeline_flush(prevPipe);
+    prevPipe = -1;
+
+    gl_enable(GL_BLEND, true);
+    gl_depth_mask(false);
+    for (size_t i = 0; i < n; ++i) {
+        if (!key_opaque(keys[i])) queue_replay(keys[i], (unsigned short)(DEPTH_PASS_MAX - i), &prevPipe, &prevTex);
+    }
+    pipeline_flush(prevPipe);
+
+    gl_depth_mask(true);
+    gl_enable(GL_DEPTH_TEST, false);
+}
+
+static void soft_emit(const unsigned long long* keys, size_t n);
+
+// Sorts and replays everything recorded so far.
+static void queue_emit(void) {
+    const size_t n = s_queue.count;
+    const double t0 = GetTime();
+    PROFILE_BEGIN("queue_emit");
+    if (n > 0) {
+        PROFILE_BEGIN("sort");
+        radix_sort_keys(s_queue.keys, s_queue.scratch, n);
+        PROFILE_END();
+
+        // Replay's own time is pushing commands into batches; flushes nest
+        PROFILE_BEGIN("replay");
+        if (s_backend == RENDER_BACKEND_SOFTWARE) {
+            soft_emit(s_queue.keys, n);
+        } else if (s_depthPass.enabled && s_depthPass.available && s_rectBatch.mode == RECT_BATCH_INSTANCED) {
+            // The indexed rect path has no per-vertex z, so it always paints in order
+            clip_upload();
+            for (size_t i = 0; i < n; i += DEPTH_PASS_MAX)
+                queue_emit_depth(s_queue.keys + i, n - i < DEPTH_PASS_MAX ? n - i : DEPTH_PASS_MAX);
+        } else {
+            clip_upload();
+            int prevPipe = -1;
+            unsigned int prevTex = 0;
+            for (size_t i = 0; i < n; ++i) queue_replay(s_queue.keys[i], 0, &prevPipe, &prevTex);
+            pipeline_flush(prevPipe);
+        }
+        PROFILE_END();
+    }
+
+    s_queue.count = 0;
+    queue_clear_grid();
+    s_timer.cur.emitMs += (GetTime() - t0) * 1e3;
+    PROFILE_END();
+}
+
+// Span [v0,v1) clipped to cell c, in cell-local coordinates
+static inline int cell_lo(int v0, int c) { const int l = v0 - (c << QUEUE_CELL_SHIFT); return l < 0 ? 0 : l; }
+static inline int cell_hi(int v1, int c) { const int l = v1 - (c << QUEUE_CELL_SHIFT); return l > QUEUE_CELL_SIZE ? QUEUE_CELL_SIZE : l; }
+
+static void queue_push(Pipeline pipe, unsigned int texBinding, int x, int y, int w, int h,
+                       Color color, unsigned int tex, RectShape shape) {
+    if (w == 0 || h == 0 || s_fbW <= 0 || s_fbH <= 0 || !s_queue.grid) return;
+
+    // Visible extent: the rect within the active clip and the framebuffer
+    const unsigned short clip = clip_current();
+    const ClipRect cr = s_clip.table[clip];
+    int x0 = w < 0 ? x + w : x, x1 = w < 0 ? x : x + w;
+    int y0 = h < 0 ? y + h : y, y1 = h < 0 ? y : y + h;
+    if (x0 < cr.x0) x0 = cr.x0;
+    if (y0 < cr.y0) y0 = cr.y0;
+    if (x1 > cr.x1) x1 = cr.x1;
+    if (y1 > cr.y1) y1 = cr.y1;
+    if (x1 <= x0 || y1 <= y0) return;                             // fully clipped
+    if (x1 <= 0 || y1 <= 0 || x0 >= s_fbW || y0 >= s_fbH) return; // fully off-screen
+
+    if (s_queue.count > KEY_SEQ_MASK) queue_emit();
+    if (s_queue.count == s_queue.cap && !queue_grow()) {
+        queue_emit(); // out of memory: draw what we have and start over
+    }
+
+    const int cx0 = (x0 < 0 ? 0 : x0) >> QUEUE_CELL_SHIFT;
+    const int cy0 = (y0 < 0 ? 0 : y0) >> QUEUE_CELL_SHIFT;
+    const int cx1 = ((x1 > s_fbW ? s_fbW : x1) - 1) >> QUEUE_CELL_SHIFT;
+    const int cy1 = ((y1 > s_fbH ? s_fbH : y1) - 1) >> QUEUE_CELL_SHIFT;
+
+    unsigned int depth = 0;
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        const int ly0 = cell_lo(y0, cy), ly1 = cell_hi(y1, cy);
+        const QueueCell* cell = s_queue.grid + ((size_t)cy * s_queue.gridW + cx0) * PIPE_COUNT;
+        for (int cx = cx0; cx <= cx1; ++cx, cell += PIPE_COUNT) {
+            const int lx0 = cell_lo(x0, cx), lx1 = cell_hi(x1, cx);
+            for (int p = 0; p < PIPE_COUNT; ++p) {
+                const QueueCell* c = &cell[p];
+                if (!c->depth || lx0 >= c->x1 || c->x0 >= lx1 || ly0 >= c->y1 || c->y0 >= ly1) continue;
+                const unsigned int need = p == (int)pipe ? c->depth - 1u : c->depth;
+                if (need > depth) depth = need;
+            }
+        }
+    }
+    if (depth >= KEY_DEPTH_MAX) {
+        queue_emit();
+        depth = 0;
+    }
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        const int ly0 = cell_lo(y0, cy), ly1 = cell_hi(y1, cy);
+        QueueCell* c = s_queue.grid + ((size_t)cy * s_queue.gridW + cx0) * PIPE_COUNT + pipe;
+        for (int cx = cx0; cx <= cx1; ++cx, c += PIPE_COUNT) {
+            const int lx0 = cell_lo(x0, cx), lx1 = cell_hi(x1, cx);
+            if (!c->depth) {
+                *c = (QueueCell){ (unsigned short)(depth + 1), (unsigned char)lx0, (unsigned char)ly0,
+                                  (unsigned char)lx1, (unsigned char)ly1 };
+                continue;
+            }
+            if (c->depth < depth + 1) c->depth = (unsigned short)(depth + 1);
+            if (lx0 < c->x0) c->x0 = (unsigned char)lx0;
+            if (ly0 < c->y0) c->y0 = (unsigned char)ly0;
+            if (lx1 > c->x1) c->x1 = (unsigned char)lx1;
+            if (ly1 > c->y1) c->y1 = (unsigned char)ly1;
+        }
+    }
+
+    const size_t seq = s_queue.count++;
+    s_queue.cmds[seq] = (DrawCmd){ x, y, w, h, color, tex, clip, shape };
+    s_queue.keys[seq] = ((unsigned long long)s_queue.layer << KEY_LAYER_SHIFT)
+                      | ((unsigned long long)depth         << KEY_DEPTH_SHIFT)
+                      | ((unsigned long long)pipe          << KEY_PIPE_SHIFT)
+                      | ((unsigned long long)texBinding    << KEY_TEX_SHIFT)
+                      | (unsigned long long)seq;
+}
+
+// Software backend
+// Rasterizes the sorted draw queue into a caller-owned RGBA8 buffer instead of
+// issuing GL. The target is cut into SOFT_BAND_ROWS-row bands that worker
+// threads claim one at a time; each band replays the whole command list
+// clipped to its rows, so draw order holds per pixel without any binning.
+// Span fills and blends use AVX2, SSE2 or NEON when the compiler targets them.
+#define SOFT_BAND_ROWS   32
+#define SOFT_MAX_THREADS 16
+
+#if defined(_WIN32)
+typedef HANDLE             SoftThread;
+typedef SRWLOCK            SoftMutex;
+typedef CONDITION_VARIABLE SoftCond;
+#define soft_mutex_init(m)     InitializeSRWLock(m)
+#define soft_mutex_destroy(m)  ((void)(m))
+#define soft_mutex_lock(m)     AcquireSRWLockExclusive(m)
+#define soft_mutex_unlock(m)   ReleaseSRWLockExclusive(m)
+#define soft_cond_init(c)      InitializeConditionVariable(c)
+#define soft_cond_destroy(c)   ((void)(c))
+#define soft_cond_wait(c, m)   SleepConditionVariableSRW((c), (m), INFINITE, 0)
+#define soft_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+typedef pthread_t          SoftThread;
+typedef pthread_mutex_t    SoftMutex;
+typedef pthread_cond_t     SoftCond;
+#define soft_mutex_init(m)     pthread_mutex_init((m), NULL)
+#define soft_mutex_destroy(m)  pthread_mutex_destroy(m)
+#define soft_mutex_lock(m)     pthread_mutex_lock(m)
+#define soft_mutex_unlock(m)   pthread_mutex_unlock(m)
+#define soft_cond_init(c)      pthread_cond_init((c), NULL)
+#define soft_cond_destroy(c)   pthread_cond_destroy(c)
+#define soft_cond_wait(c, m)   pthread_cond_wait((c), (m))
+#define soft_cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+typedef struct SoftBackend {
+    unsigned char* target;   // RGBA8, top-down
+    int width, height;
+    size_t stride;           // bytes per row
+
+    unsigned char** pixels;  // CPU copies of loaded images, indexed by Texture.id
+    size_t pixelsCap;
+    bool keepPixels;         // set once the software backend is selected
+    bool alphaOver;          // render texture target: dst alpha uses src-over
+    float scale;             // dynamic resolution: commands shrink by this at emit
+    const ClipRect* clips;   // clip table for the current job (scaled copy or s_clip.table)
+    ClipRect* scaledClips;
+    size_t scaledClipCap;
+
+    // Band workers
+    SoftMutex  mutex;
+    SoftCond   wake;         // workers: a new job (or quit) was posted
+    SoftCond   idle;         // caller: the last worker finished the job
+    SoftThread threads[SOFT_MAX_THREADS];
+    int  threadCount;
+    bool poolStarted;
+    bool quit;
+    unsigned int generation; // bumped per job
+    int  busy;               // workers still on the current job
+
+    void (*job)(int band);          // current job, run once per band
+    const unsigned long long* keys; // raster job: sorted queue keys
+    size_t count;
+    int nextBand, bandCount;
+} SoftBackend;
+
+static SoftBackend s_soft = {0};
+
+static inline unsigned int div255(unsigned int v) { return (v + (v >> 8)) >> 8; } // v already has +128
+
+static inline uint32_t soft_pack(const unsigned char c[4]) {
+    uint32_t v;
+    memcpy(&v, c, 4);
+    return v;
+}
+
+static void soft_fill_span(uint32_t* d, int n, uint32_t c) {
+    int i = 0;
+#if defined(SIMD_AVX2)
+    const __m256i v = _mm256_set1_epi32((int)c);
+    for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(d + i), v);
+#elif defined(SIMD_SSE2)
+    const __m128i v = _mm_set1_epi32((int)c);
+    for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i*)(d + i), v);
+#elif defined(SIMD_NEON)
+    const uint32x4_t v = vdupq_n_u32(c);
+    for (; i + 4 <= n; i += 4) vst1q_u32(d + i, v);
+#endif
+    for (; i < n; ++i) d[i] = c;
+}
+
+// dst = src * a + dst * (1 - a) on every channel, alpha included, matching
+// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) on an RGBA8 target. Inside
+// texture mode alpha takes the src-over term (a + dst * (1 - a)) instead, as
+// BeginTextureMode's separate alpha blend does.
+static inline void soft_blend_px(unsigned char* d, const unsigned char s[4], unsigned int a) {
+    const unsigned int ia = 255 - a;
+    const unsigned int sa = s_soft.alphaOver ? 255 : s[3];
+    for (int k = 0; k < 3; ++k) d[k] = (unsigned char)div255(s[k] * a + d[k] * ia + 128);
+    d[3] = (unsigned char)div255(sa * a + d[3] * ia + 128);
+}
+
+static void soft_blend_span(uint32_t* d, int n, const unsigned char s[4], unsigned int a) {
+    const unsigned int sa = s_soft.alphaOver ? 255 : s[3];
+    const unsigned short add[4] = {
+        (unsigned short)(s[0] * a + 128), (unsigned short)(s[1] * a + 128),
+        (unsigned short)(s[2] * a + 128), (unsigned short)(sa * a + 128)
+    };
+    const unsigned int ia = 255 - a;
+    int i = 0;
+#if defined(SIMD_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i vadd = _mm256_setr_epi16(add[0], add[1], add[2], add[3], add[0], add[1], add[2], add[3],
+                                           add[0], add[1], add[2], add[3], add[0], add[1], add[2], add[3]);
+    const __m256i vinv = _mm256_set1_epi16((short)ia);
+    for (; i + 8 <= n; i += 8) {
+        const __m256i px = _mm256_loadu_si256((const __m256i*)(d + i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(px, zero), vinv), vadd);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(px, zero), vinv), vadd);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_packus_epi16(lo, hi));
+    }
+#elif defined(SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vadd = _mm_setr_epi16(add[0], add[1], add[2], add[3], add[0], add[1], add[2], add[3]);
+    const __m128i vinv = _mm_set1_epi16((short)ia);
+    for (; i + 4 <= n; i += 4) {
+        const __m128i px = _mm_loadu_si128((const __m128i*)(d + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), vinv), vadd);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), vinv), vadd);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i*)(d + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(SIMD_NEON)
+    const uint16x4_t add4 = vld1_u16(add);
+    const uint16x8_t vadd = vcombine_u16(add4, add4);
+    const uint8x8_t  vinv = vdup_n_u8((uint8_t)ia);
+    for (; i + 4 <= n; i += 4) {
+        const uint8x16_t px = vld1q_u8((const uint8_t*)(d + i));
+        uint16x8_t lo = vmlal_u8(vadd, vget_low_u8(px), vinv);
+        uint16x8_t hi = vmlal_u8(vadd, vget_high_u8(px), vinv);
+        lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+        hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+        vst1q_u8((uint8_t*)(d + i), vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+    }
+#endif
+    for (; i < n; ++i) {
+        unsigned char* p = (unsigned char*)(d + i);
+        for (int k = 0; k < 4; ++k) p[k] = (unsigned char)div255(add[k] + p[k] * ia);
+    }
+}
+
+static inline void soft_span(unsigned char* row, int x0, int x1, const unsigned char c[4]) {
+    if (x1 <= x0) return;
+    if (c[3] == 255) soft_fill_span((uint32_t*)row + x0, x1 - x0, soft_pack(c));
+    else             soft_blend_span((uint32_t*)row + x0, x1 - x0, c, c[3]);
+}
+
+// C port of box_sdf in s_rectInstFS
+static float soft_box_sdf(float px, float py, float lox, float loy, float hix, float hiy, const float r[4]) {
+    const float cx = 0.5f * (lox + hix), cy = 0.5f * (loy + hiy);
+    const float hx = 0.5f * (hix - lox), hy = 0.5f * (hiy - loy);
+    float k = py < cy ? (px < cx ? r[0] : r[1]) : (px < cx ? r[2] : r[3]);
+    k = fminf(k, fminf(hx, hy));
+    const float qx = fabsf(px - cx) - hx + k, qy = fabsf(py - cy) - hy + k;
+    const float ox = fmaxf(qx, 0.0f), oy = fmaxf(qy, 0.0f);
+    return fminf(fmaxf(qx, qy), 0.0f) + sqrtf(ox * ox + oy * oy) - k;
+}
+
+static inline float clamp01(float v) { return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v); }
+
+static float soft_shape_cover(float px, float py, float w, float h, const RectShape* s) {
+    const float r[4] = { s->radius[0], s->radius[1], s->radius[2], s->radius[3] };
+    float cover = clamp01(0.5f - soft_box_sdf(px, py, 0.0f, 0.0f, w, h, r));
+    const float bl = s->border[0], br = s->border[1], bt = s->border[2], bb = s->border[3];
+    if (bl + br + bt + bb > 0.0f && w - br > bl && h - bb > bt) {
+        const float inner[4] = {
+            fmaxf(r[0] - fmaxf(bl, bt), 0.0f), fmaxf(r[1] - fmaxf(br, bt), 0.0f),
+            fmaxf(r[2] - fmaxf(bl, bb), 0.0f), fmaxf(r[3] - fmaxf(br, bb), 0.0f)
+        };
+        cover *= 1.0f - clamp01(0.5f - soft_box_sdf(px, py, bl, bt, w - br, h - bb, inner));
+    }
+    return cover;
+}
+
+// Visible span of [v0,v1) within a clip range and [lo,hi)
+static inline void soft_clip_span(int* v0, int* v1, int c0, int c1, int lo, int hi) {
+    if (*v0 < c0) *v0 = c0;
+    if (*v0 < lo) *v0 = lo;
+    if (*v1 > c1) *v1 = c1;
+    if (*v1 > hi) *v1 = hi;
+}
+
+static void soft_rect(const DrawCmd* c, int by0, int by1) {
+    int rx = c->w < 0 ? c->x + c->w : c->x, rw = c->w < 0 ? -c->w : c->w;
+    int ry = c->h < 0 ? c->y + c->h : c->y, rh = c->h < 0 ? -c->h : c->h;
+    const ClipRect cr = s_soft.clips[c->clip];
+    int x0 = rx, x1 = rx + rw, y0 = ry, y1 = ry + rh;
+    soft_clip_span(&x0, &x1, cr.x0, cr.x1, 0, s_soft.width);
+    soft_clip_span(&y0, &y1, cr.y0, cr.y1, by0, by1);
+    if (x1 <= x0 || y1 <= y0) return;
+
+    const unsigned char col[4] = { unorm8(c->color.r), unorm8(c->color.g), unorm8(c->color.b), unorm8(c->color.a) };
+    if (col[3] == 0) return;
+    const RectShape* s = &c->shape;
+    const bool flat = memcmp(s, &s_flatShape, sizeof *s) == 0;
+
+    // Rows clear of every corner radius and the top/bottom borders are plain
+    // spans: the whole width, or just the left and right border strips.
+    // Likewise, in the remaining rows only the columns under a corner radius
+    // need per-pixel coverage; the columns between them are a span or hole.
+    int bandLo = 0, bandHi = rh;
+    int colL = 0, colR = rw;
+    int stripL = rw, stripR = 0; // no hole
+    if (!flat) {
+        const int rt = s->radius[0] > s->radius[1] ? s->radius[0] : s->radius[1];
+        const int rb = s->radius[2] > s->radius[3] ? s->radius[2] : s->radius[3];
+        const int rl = s->radius[0] > s->radius[2] ? s->radius[0] : s->radius[2];
+        const int rr = s->radius[1] > s->radius[3] ? s->radius[1] : s->radius[3];
+        bandLo = rt > s->border[2] ? rt : s->border[2];
+        bandHi = rh - (rb > s->border[3] ? rb : s->border[3]);
+        colL = rl > s->border[0] ? rl : s->border[0];
+        colR = rw - (rr > s->border[1] ? rr : s->border[1]);
+        if (colR < colL) colL = colR = rw;
+        if ((s->border[0] | s->border[1] | s->border[2] | s->border[3]) &&
+            s->border[0] + s->border[1] < rw && s->border[2] + s->border[3] < rh) {
+            stripL = s->border[0];
+            stripR = rw - s->border[1];
+        }
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        unsigned char* row = s_soft.target + (size_t)y * s_soft.stride;
+        const int ly = y - ry;
+        if (ly >= bandLo && ly < bandHi) {
+            if (stripL >= stripR) {
+                soft_span(row, x0, x1, col);
+            } else {
+                soft_span(row, x0, rx + stripL < x1 ? rx + stripL : x1, col);
+                soft_span(row, rx + stripR > x0 ? rx + stripR : x0, x1, col);
+            }
+            continue;
+        }
+        const int midL = rx + colL > x0 ? rx + colL : x0, midR = rx + colR < x1 ? rx + colR : x1;
+        if (midL < midR && (stripL >= stripR || ly < s->border[2] || ly >= rh - s->border[3])) {
+            soft_span(row, midL, midR, col);
+        }
+        for (int x = x0; x < x1; ++x) {
+            if (x == midL && midL < midR) x = midR;
+            if (x >= x1) break;
+            const float cover = soft_shape_cover((float)(x - rx) + 0.5f, (float)ly + 0.5f, (float)rw, (float)rh, s);
+            const unsigned int a = (unsigned int)(col[3] * cover + 0.5f);
+            if (a == 0) continue;
+            const unsigned char src[4] = { col[0], col[1], col[2], (unsigned char)a };
+            soft_blend_px(row + (size_t)x * 4, src, a);
+        }
+    }
+}
+
+// Bilinear sample position along one axis for destination pixel d of n,
+// matching the sprite shader: mirrored when flipped and clamped to the
+// image's own texel centres. i0/i1 are the neighbouring texels, the return
+// value the weight of i1 in 1/256ths.
+static inline int soft_texel_lerp(int d, int n, int size, bool flip, int* i0, int* i1) {
+    float u = ((float)d + 0.5f) * (float)size / (float)n;
+    if (flip) u = (float)size - u;
+    u -= 0.5f;
+    if (u < 0.0f) u = 0.0f;
+    if (u > (float)(size - 1)) u = (float)(size - 1);
+    *i0 = (int)u;
+    *i1 = *i0 + (*i0 < size - 1);
+    return (int)((u - (float)*i0) * 256.0f + 0.5f);
+}
+
+static void soft_sprite(const DrawCmd* c, int by0, int by1) {
+    const unsigned char* img = c->tex < s_soft.pixelsCap ? s_soft.pixels[c->tex] : NULL;
+    if (!img) return;
+    const TexImage* ti = &s_texBatch.images[c->tex];
+    const int iw = ti->w, ih = ti->h;
+    const bool premul = (ti->flags & SPRITE_PREMULTIPLIED) != 0;
+
+    const bool flipX = c->w < 0, flipY = c->h < 0;
+    const int rx = flipX ? c->x + c->w : c->x, rw = flipX ? -c->w : c->w;
+    const int ry = flipY ? c->y + c->h : c->y, rh = flipY ? -c->h : c->h;
+    const ClipRect cr = s_soft.clips[c->clip];
+    int x0 = rx, x1 = rx + rw, y0 = ry, y1 = ry + rh;
+    soft_clip_span(&x0, &x1, cr.x0, cr.x1, 0, s_soft.width);
+    soft_clip_span(&y0, &y1, cr.y0, cr.y1, by0, by1);
+    if (x1 <= x0 || y1 <= y0) return;
+
+    const unsigned char tint[4] = { unorm8(c->color.r), unorm8(c->color.g), unorm8(c->color.b), unorm8(c->color.a) };
+    for (int y = y0; y < y1; ++y) {
+        int v0, v1;
+        const int fy = soft_texel_lerp(y - ry, rh, ih, flipY, &v0, &v1);
+        const unsigned char* srow0 = img + (size_t)v0 * iw * 4;
+        const unsigned char* srow1 = img + (size_t)v1 * iw * 4;
+        unsigned char* row = s_soft.target + (size_t)y * s_soft.stride;
+        for (int x = x0; x < x1; ++x) {
+            int u0, u1;
+            const int fx = soft_texel_lerp(x - rx, rw, iw, flipX, &u0, &u1);
+            const unsigned char *a = srow0 + (size_t)u0 * 4, *b = srow0 + (size_t)u1 * 4;
+            const unsigned char *d = srow1 + (size_t)u0 * 4, *e = srow1 + (size_t)u1 * 4;
+            unsigned char t[4];
+            for (int k = 0; k < 4; ++k) {
+                const unsigned int top = a[k] * (256u - fx) + b[k] * (unsigned)fx;
+                const unsigned int bot = d[k] * (256u - fx) + e[k] * (unsigned)fx;
+                t[k] = (unsigned char)((top * (256u - fy) + bot * (unsigned)fy + 32768u) >> 16);
+            }
+            // Premultiplied render textures are divided back out after
+            // filtering, like the sprite shader
+            if (premul && t[3] && t[3] < 255) {
+                for (int k = 0; k < 3; ++k) {
+                    const unsigned int v = (t[k] * 255u + t[3] / 2) / t[3];
+                    t[k] = (unsigned char)(v > 255 ? 255 : v);
+                }
+            }
+            const unsigned char src[4] = {
+                (unsigned char)div255(t[0] * tint[0] + 128), (unsigned char)div255(t[1] * tint[1] + 128),
+                (unsigned char)div255(t[2] * tint[2] + 128), (unsigned char)div255(t[3] * tint[3] + 128)
+            };
+            if (src[3] == 255) memcpy(row + (size_t)x * 4, src, 4);
+            else if (src[3]) soft_blend_px(row + (size_t)x * 4, src, src[3]);
+        }
+    }
+}
+
+static void soft_raster_band(int band) {
+    const int by0 = band * SOFT_BAND_ROWS;
+    const int by1 = by0 + SOFT_BAND_ROWS < s_soft.height ? by0 + SOFT_BAND_ROWS : s_soft.height;
+    for (size_t i = 0; i < s_soft.count; ++i) {
+        const unsigned long long key = s_soft.keys[i];
+        const DrawCmd* c = &s_queue.cmds[key & KEY_SEQ_MASK];
+        const int top = c->h < 0 ? c->y + c->h : c->y;
+        if (top >= by1 || top + abs(c->h) <= by0) continue;
+        if (((key >> KEY_PIPE_SHIFT) & 0xF) == PIPE_RECT) soft_rect(c, by0, by1);
+        else                                              soft_sprite(c, by0, by1);
+    }
+}
+
+static void soft_run_bands(void) {
+    for (;;) {
+        soft_mutex_lock(&s_soft.mutex);
+        const int band = s_soft.nextBand < s_soft.bandCount ? s_soft.nextBand++ : -1;
+        soft_mutex_unlock(&s_soft.mutex);
+        if (band < 0) return;
+        PROFILE_BEGIN("soft band");
+        s_soft.job(band);
+        PROFILE_END();
+    }
+}
+
+static void soft_worker(void) {
+    unsigned int seen = 0;
+    soft_mutex_lock(&s_soft.mutex);
+    for (;;) {
+        while (!s_soft.quit && s_soft.generation == seen) soft_cond_wait(&s_soft.wake, &s_soft.mutex);
+        if (s_soft.quit) break;
+        seen = s_soft.generation;
+        soft_mutex_unlock(&s_soft.mutex);
+        soft_run_bands();
+        soft_mutex_lock(&s_soft.mutex);
+        if (--s_soft.busy == 0) soft_cond_broadcast(&s_soft.idle);
+    }
+    soft_mutex_unlock(&s_soft.mutex);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI soft_worker_main(LPVOID arg) { (void)arg; soft_worker(); return 0; }
+#else
+static void* soft_worker_main(void* arg) { (void)arg; soft_worker(); return NULL; }
+#endif
+
+static int soft_cpu_count(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// The caller rasterizes bands too, so one worker per remaining core.
+static void soft_pool_start(void) {
+    s_soft.poolStarted = true;
+    soft_mutex_init(&s_soft.mutex);
+    soft_cond_init(&s_soft.wake);
+    soft_cond_init(&s_soft.idle);
+    int n = soft_cpu_count() - 1;
+    if (n > SOFT_MAX_THREADS) n = SOFT_MAX_THREADS;
+    for (int i = 0; i < n; ++i) {
+#if defined(_WIN32)
+        s_soft.threads[i] = CreateThread(NULL, 0, soft_worker_main, NULL, 0, NULL);
+        if (!s_soft.threads[i]) break;
+#else
+        if (pthread_create(&s_soft.threads[i], NULL, soft_worker_main, NULL) != 0) break;
+#endif
+        s_soft.threadCount++;
+    }
+}
+
+static void soft_shutdown(void) {
+    if (s_soft.poolStarted) {
+        soft_mutex_lock(&s_soft.mutex);
+        s_soft.quit = true;
+        soft_cond_broadcast(&s_soft.wake);
+        soft_mutex_unlock(&s_soft.mutex);
+        for (int i = 0; i < s_soft.threadCount; ++i) {
+#if defined(_WIN32)
+            WaitForSingleObject(s_soft.threads[i], INFINITE);
+            CloseHandle(s_soft.threads[i]);
+#else
+            pthread_join(s_soft.threads[i], NULL);
+#endif
+        }
+        soft_cond_destroy(&s_soft.wake);
+        soft_cond_destroy(&s_soft.idle);
+        soft_mutex_destroy(&s_soft.mutex);
+    }
+    for (size_t i = 0; i < s_soft.pixelsCap; ++i) MemFree(s_soft.pixels[i]);
+    MemFree(s_soft.pixels);
+    MemFree(s_soft.scaledClips);
+    memset(&s_soft, 0, sizeof s_soft);
+}
+
+// Keeps a CPU copy of image id for the software sprite path.
+static void soft_keep_pixels(size_t id, const unsigned char* rgba, int width, int height) {
+    if (id >= s_soft.pixelsCap) {
+        size_t newCap = s_soft.pixelsCap ? s_soft.pixelsCap : 64;
+        while (newCap <= id) newCap *= 2;
+        unsigned char** p = (unsigned char**)MemRealloc(MEM_TEXTURES, s_soft.pixels, newCap * sizeof *p);
+        if (!p) {
+            fprintf(stderr, "Out of memory keeping texture pixels for the software backend.\n");
+            return;
+        }
+        memset(p + s_soft.pixelsCap, 0, (newCap - s_soft.pixelsCap) * sizeof *p);
+        s_soft.pixels = p;
+        s_soft.pixelsCap = newCap;
+    }
+    const size_t bytes = (size_t)width * height * 4;
+    MemFree(s_soft.pixels[id]);
+    s_soft.pixels[id] = (unsigned char*)MemAlloc(MEM_TEXTURES, bytes);
+    if (s_soft.pixels[id]) memcpy(s_soft.pixels[id], rgba, bytes);
+}
+
+// Runs job over bandCount bands on the pool and the calling thread.
+static void soft_run_job(void (*job)(int band), int bandCount) {
+    if (!s_soft.poolStarted) soft_pool_start();
+
+    soft_mutex_lock(&s_soft.mutex);
+    s_soft.job = job;
+    s_soft.nextBand = 0;
+    s_soft.bandCount = bandCount;
+    s_soft.busy = s_soft.threadCount;
+    s_soft.generation++;
+    soft_cond_broadcast(&s_soft.wake);
+    soft_mutex_unlock(&s_soft.mutex);
+
+    soft_run_bands();
+
+    soft_mutex_lock(&s_soft.mutex);
+    while (s_soft.busy > 0) soft_cond_wait(&s_soft.idle, &s_soft.mutex);
+    soft_mutex_unlock(&s_soft.mutex);
+}
+
+static inline int soft_scale_px(int v, float s) {
+    return (int)floorf((float)v * s + 0.5f);
+}
+
+// Dynamic resolution: shrinks the queued commands (consumed by this emit) and
+// a copy of the clip table by s_soft.scale. Edges are scaled, not sizes, so
+// abutting rects stay abutting.
+static bool soft_scale_commands(const unsigned long long* keys, size_t n) {
+    if (s_clip.count > s_soft.scaledClipCap) {
+        ClipRect* t = (ClipRect*)MemRealloc(MEM_RENDERER, s_soft.scaledClips, s_clip.count * sizeof(ClipRect));
+        if (!t) {
+            fprintf(stderr, "Out of memory scaling clip rects.\n");
+            return false;
+        }
+        s_soft.scaledClips = t;
+        s_soft.scaledClipCap = s_clip.count;
+    }
+    const float sc = s_soft.scale;
+    for (size_t i = 0; i < s_clip.count; ++i) {
+        const ClipRect r = s_clip.table[i];
+        s_soft.scaledClips[i] = (ClipRect){
+            (short)soft_scale_px(r.x0, sc), (short)soft_scale_px(r.y0, sc),
+            (short)soft_scale_px(r.x1, sc), (short)soft_scale_px(r.y1, sc)
+        };
+    }
+    for (size_t i = 0; i < n; ++i) {
+        DrawCmd* c = &s_queue.cmds[keys[i] & KEY_SEQ_MASK];
+        const int x0 = soft_scale_px(c->x, sc), x1 = soft_scale_px(c->x + c->w, sc);
+        const int y0 = soft_scale_px(c->y, sc), y1 = soft_scale_px(c->y + c->h, sc);
+        c->x = x0; c->w = x1 - x0;
+        c->y = y0; c->h = y1 - y0;
+        for (int k = 0; k < 4; ++k) {
+            c->shape.radius[k] = (unsigned char)soft_scale_px(c->shape.radius[k], sc);
+            c->shape.border[k] = (unsigned char)soft_scale_px(c->shape.border[k], sc);
+        }
+    }
+    s_soft.clips = s_soft.scaledClips;
+    return true;
+}
+
+static void soft_emit(const unsigned long long* keys, size_t n) {
+    if (!s_soft.target) return;
+    s_soft.clips = s_clip.table;
+    if (s_soft.scale > 0.0f && s_soft.scale < 1.0f && !soft_scale_commands(keys, n)) return;
+
+    s_soft.keys = keys;
+    s_soft.count = n;
+    soft_run_job(soft_raster_band, (s_soft.height + SOFT_BAND_ROWS - 1) / SOFT_BAND_ROWS);
+
+    s_timer.cur.quads += (unsigned int)n;
+}
+
+// Render textures
+// Draws between BeginTextureMode and EndTextureMode go to a scratch
+// framebuffer sized to the largest target so far rather than to the texture
+// array, which sprites may still be sampling; EndTextureMode blits the result
+// into the target's region, flipped to the array's top-down rows. The target
+// starts transparent and alpha blends src-over, so it holds premultiplied
+// color that the sprite path divides back out.
+#define RENDER_TEXTURE_ALIGN 64 // regrown regions round up to this
+
+typedef struct RenderTarget {
+    bool active;
+    size_t id;              // target image
+    GLuint fbo, color;      // scratch framebuffer and its RGBA8 renderbuffer
+    GLuint blitFbo;         // draw framebuffer over an array layer
+    int capW, capH;
+
+    // Enclosing frame, restored by EndTextureMode
+    GLint prevFbo;
+    int prevW, prevH;
+    int prevClipDepth;
+    unsigned int prevLayer;
+    bool prevDepthAvail;
+    unsigned char* prevSoft;
+    int prevSoftW, prevSoftH;
+    size_t prevSoftStride;
+} RenderTarget;
+
+static RenderTarget s_rt = {0};
+
+// Last uViewport / uScale sent to the programs; w = 0 forces a resend
+typedef struct ViewUniforms {
+    int w, h;
+    float scale;
+} ViewUniforms;
+
+static ViewUniforms s_viewUniforms = {0};
+
+static void set_viewport_uniforms(int w, int h, float scale) {
+    if (w == s_viewUniforms.w && h == s_viewUniforms.h && scale == s_viewUniforms.scale) return;
+    s_viewUniforms = (ViewUniforms){ w, h, scale };
+    gl_use_program(s_rectBatch.prog);
+    glUniform2f(s_rectBatch.viewportLoc, (float)w, (float)h);
+    gl_use_program(s_rectBatch.instProg);
+    glUniform2f(s_rectBatch.instViewportLoc, (float)w, (float)h);
+    glUniform1f(s_rectBatch.instScaleLoc, scale);
+    gl_use_program(s_texBatch.prog);
+    glUniform2f(s_texBatch.viewportLoc, (float)w, (float)h);
+}
+
+// Grows the scratch framebuffer to at least w*h; leaves it bound.
+static bool rendertarget_reserve(int w, int h) {
+    if (!s_rt.fbo) {
+        glGenFramebuffers(1, &s_rt.fbo);
+        glGenFramebuffers(1, &s_rt.blitFbo);
+        glGenRenderbuffers(1, &s_rt.color);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, s_rt.fbo);
+    if (w <= s_rt.capW && h <= s_rt.capH) return true;
+
+    const int cw = w > s_rt.capW ? w : s_rt.capW;
+    const int ch = h > s_rt.capH ? h : s_rt.capH;
+    glBindRenderbuffer(GL_RENDERBUFFER, s_rt.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, cw, ch);
+    MemTrackGpu(MEM_GPU_TEXTURES, 4ll * cw * ch - 4ll * s_rt.capW * s_rt.capH);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, s_rt.color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Render texture framebuffer incomplete (%dx%d).\n", cw, ch);
+        MemTrackGpu(MEM_GPU_TEXTURES, -4ll * cw * ch);
+        s_rt.capW = s_rt.capH = 0;
+        return false;
+    }
+    s_rt.capW = cw;
+    s_rt.capH = ch;
+    return true;
+}
+
+static void rendertarget_shutdown(void) {
+    if (s_rt.fbo) {
+        glDeleteFramebuffers(1, &s_rt.fbo);
+        glDeleteFramebuffers(1, &s_rt.blitFbo);
+        glDeleteRenderbuffers(1, &s_rt.color);
+        MemTrackGpu(MEM_GPU_TEXTURES, -4ll * s_rt.capW * s_rt.capH);
+    }
+    memset(&s_rt, 0, sizeof s_rt);
+}
+
+// Dynamic resolution
+// While on, Begin2D points the frame at an offscreen target of
+// fbW*scale x fbH*scale. The shaders keep mapping framebuffer pixels through
+// uViewport, so draws are unchanged and only the viewport shrinks; the
+// software backend scales the commands at emit instead. BeginNativeResolution
+// or End2D upscales the target into the framebuffer with linear filtering.
+// The scale tracks a smoothed max(cpuMs, gpuMs) against the target, taking
+// frame time as proportional to pixel count, i.e. to scale squared.
+#define DYNRES_SETTLE_FRAMES 8     // measured frames between scale changes
+#define DYNRES_MAX_DROP      0.25f // largest step down per change
+#define DYNRES_MAX_RISE      0.1f  // largest step up, so recovery is gradual
+
+typedef struct DynRes {
+    bool   enabled;
+    double targetMs;
+    float  minScale;
+    float  scale;           // used from the next Begin2D
+    double avgMs;           // smoothed frame time at this scale
+    int    frames;          // measured frames at this scale; < 0 while older GPU times drain
+
+    bool  active;           // the current frame renders scaled
+    float frameScale;
+    int   w, h;             // scaled size this frame
+
+    GLuint fbo, color, depth;
+    int    capW, capH;
+    GLint  prevFbo;
+
+    unsigned char* soft;    // software scaled target
+    size_t softBytes;
+    unsigned char* prevSoft;
+    int    prevSoftW, prevSoftH;
+    size_t prevSoftStride;
+    int*   xmap;            // upscale: source column and weight per target column
+    int    xmapCap;
+} DynRes;
+
+static DynRes s_dyn = {0};
+
+// Viewport and uniforms (or software scale) for the frame's current target
+static void frame_viewport(void) {
+    if (s_backend == RENDER_BACKEND_SOFTWARE) {
+        s_soft.scale = s_dyn.active ? s_dyn.frameScale : 1.0f;
+        return;
+    }
+    if (s_dyn.active) {
+        gl_viewport(0, 0, s_dyn.w, s_dyn.h);
+        set_viewport_uniforms(s_fbW, s_fbH, s_dyn.frameScale);
+    } else {
+        gl_viewport(0, 0, s_fbW, s_fbH);
+        set_viewport_uniforms(s_fbW, s_fbH, 1.0f);
+    }
+}
+
+// Grows the scaled framebuffer to at least w*h; leaves it bound.
+static bool dynres_reserve(int w, int h) {
+    if (!s_dyn.fbo) {
+        glGenFramebuffers(1, &s_dyn.fbo);
+        glGenRenderbuffers(1, &s_dyn.color);
+        glGenRenderbuffers(1, &s_dyn.depth); // for the opaque depth pass
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, s_dyn.fbo);
+    if (w <= s_dyn.capW && h <= s_dyn.capH) return true;
+
+    const int cw = w > s_dyn.capW ? w : s_dyn.capW;
+    const int ch = h > s_dyn.capH ? h : s_dyn.capH;
+    glBindRenderbuffer(GL_RENDERBUFFER, s_dyn.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, cw, ch);
+    glBindRenderbuffer(GL_RENDERBUFFER, s_dyn.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, cw, ch);
+    // Color plus depth, which drivers pad to 4 bytes
+    MemTrackGpu(MEM_GPU_TEXTURES, 8ll * cw * ch - 8ll * s_dyn.capW * s_dyn.capH);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, s_dyn.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, s_dyn.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Dynamic resolution framebuffer incomplete (%dx%d).\n", cw, ch);
+        MemTrackGpu(MEM_GPU_TEXTURES, -8ll * cw * ch);
+        s_dyn.capW = s_dyn.capH = 0;
+        return false;
+    }
+    s_dyn.capW = cw;
+    s_dyn.capH = ch;
+    return true;
+}
+
+// Redirects the frame to the scaled target, seeded with a downscaled copy of
+// what the framebuffer already holds (e.g. ClearBackground).
+static void dynres_begin(int fbW, int fbH) {
+    s_dyn.active = false;
+    if (!s_dyn.enabled || s_dyn.scale >= 1.0f) return;
+    const float sc = s_dyn.scale;
+    int w = soft_scale_px(fbW, sc), h = soft_scale_px(fbH, sc);
+    if (w < 1) w = 1;
+    if (h < 1) h = 1;
+
+    if (s_backend == RENDER_BACKEND_SOFTWARE) {
+        if (!s_soft.target) return;
+        const size_t bytes = (size_t)w * h * 4;
+        if (bytes > s_dyn.softBytes) {
+            unsigned char* p = (unsigned char*)MemRealloc(MEM_RENDERER, s_dyn.soft, bytes);
+            if (!p) {
+                fprintf(stderr, "Out of memory for the dynamic resolution target.\n");
+                return;
+            }
+            s_dyn.soft = p;
+            s_dyn.softBytes = bytes;
+        }
+        for (int y = 0; y < h; ++y) {
+            const int sy = (int)(((float)y + 0.5f) * s_soft.height / h);
+            const uint32_t* src = (const uint32_t*)(s_soft.target + (size_t)sy * s_soft.stride);
+            uint32_t* dst = (uint32_t*)(s_dyn.soft + (size_t)y * w * 4);
+            for (int x = 0; x < w; ++x) dst[x] = src[(int)(((float)x + 0.5f) * s_soft.width / w)];
+        }
+        s_dyn.prevSoft = s_soft.target;
+        s_dyn.prevSoftW = s_soft.width;
+        s_dyn.prevSoftH = s_soft.height;
+        s_dyn.prevSoftStride = s_soft.stride;
+        s_soft.target = s_dyn.soft;
+        s_soft.width = w;
+        s_soft.height = h;
+        s_soft.stride = (size_t)w * 4;
+    } else {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &s_dyn.prevFbo);
+        if (!dynres_reserve(w, h)) {
+            glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)s_dyn.prevFbo);
+            return;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)s_dyn.prevFbo);
+        glBlitFramebuffer(0, 0, fbW, fbH, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, s_dyn.fbo);
+    }
+    s_dyn.active = true;
+    s_dyn.frameScale = sc;
+    s_dyn.w = w;
+    s_dyn.h = h;
+}
+
+// Bilinear upscale of the scaled software target, one band of target rows
+static void soft_upscale_band(int band) {
+    const int sw = s_dyn.w, sh = s_dyn.h;
+    const int y0 = band * SOFT_BAND_ROWS;
+    const int y1 = y0 + SOFT_BAND_ROWS < s_soft.height ? y0 + SOFT_BAND_ROWS : s_soft.height;
+    for (int y = y0; y < y1; ++y) {
+        float fy = ((float)y + 0.5f) * sh / s_soft.height - 0.5f;
+        if (fy < 0.0f) fy = 0.0f;
+        const int iy = (int)fy, iy1 = iy + 1 < sh ? iy + 1 : sh - 1;
+        const unsigned int wy = (unsigned int)((fy - (float)iy) * 256.0f);
+        const unsigned char* r0 = s_dyn.soft + (size_t)iy * sw * 4;
+        const unsigned char* r1 = s_dyn.soft + (size_t)iy1 * sw * 4;
+        unsigned char* out = s_soft.target + (size_t)y * s_soft.stride;
+        for (int x = 0; x < s_soft.width; ++x) {
+            const int ix = s_dyn.xmap[2 * x];
+            const unsigned int wx = (unsigned int)s_dyn.xmap[2 * x + 1];
+            const int ix1 = ix + 1 < sw ? ix + 1 : ix;
+            for (int k = 0; k < 4; ++k) {
+                const unsigned int top = r0[ix * 4 + k] * (256 - wx) + r0[ix1 * 4 + k] * wx;
+                const unsigned int bot = r1[ix * 4 + k] * (256 - wx) + r1[ix1 * 4 + k] * wx;
+                out[x * 4 + k] = (unsigned char)((top * (256 - wy) + bot * wy + 32768) >> 16);
+            }
+        }
+    }
+}
+
+// Draws what is queued into the scaled target and upscales it into the
+// framebuffer; later draws go to the framebuffer directly.
+static void dynres_resolve(void) {
+    if (!s_dyn.active) return;
+    queue_emit();
+    s_dyn.active = false;
+
+    if (s_backend == RENDER_BACKEND_SOFTWARE) {
+        s_soft.target = s_dyn.prevSoft;
+        s_soft.width = s_dyn.prevSoftW;
+        s_soft.height = s_dyn.prevSoftH;
+        s_soft.stride = s_dyn.prevSoftStride;
+        if (s_soft.width > s_dyn.xmapCap) {
+            int* m = (int*)MemRealloc(MEM_RENDERER, s_dyn.xmap, (size_t)s_soft.width * 2 * sizeof(int));
+            if (!m) {
+                fprintf(stderr, "Out of memory upscaling the dynamic resolution target.\n");
+                frame_viewport();
+                return;
+            }
+            s_dyn.xmap = m;
+            s_dyn.xmapCap = s_soft.width;
+        }
+        for (int x = 0; x < s_soft.width; ++x) {
+            float fx = ((float)x + 0.5f) * s_dyn.w / s_soft.width - 0.5f;
+            if (fx < 0.0f) fx = 0.0f;
+            s_dyn.xmap[2 * x] = (int)fx;
+            s_dyn.xmap[2 * x + 1] = (int)((fx - (float)(int)fx) * 256.0f);
+        }
+        soft_run_job(soft_upscale_band, (s_soft.height + SOFT_BAND_ROWS - 1) / SOFT_BAND_ROWS);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, s_dyn.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)s_dyn.prevFbo);
+        glBlitFramebuffer(0, 0, s_dyn.w, s_dyn.h, 0, 0, s_fbW, s_fbH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)s_dyn.prevFbo);
+        if (s_depthPass.enabled) s_depthPass.available = framebuffer_has_depth();
+    }
+    frame_viewport();
+}
+
+// Feeds one frame's time to the scale controller.
+static void dynres_update(double ms) {
+    if (!s_dyn.enabled) return;
+    if (s_dyn.frames++ < 0) return;
+    s_dyn.avgMs = s_dyn.frames == 1 ? ms : s_dyn.avgMs * 0.9 + ms * 0.1;
+    if (s_dyn.frames < DYNRES_SETTLE_FRAMES || s_dyn.avgMs <= 0.0) return;
+
+    float want = s_dyn.scale * (float)sqrt(s_dyn.targetMs / s_dyn.avgMs);
+    if (want < s_dyn.scale - DYNRES_MAX_DROP) want = s_dyn.scale - DYNRES_MAX_DROP;
+    if (want > s_dyn.scale + DYNRES_MAX_RISE) want = s_dyn.scale + DYNRES_MAX_RISE;
+    if (want < s_dyn.minScale) want = s_dyn.minScale;
+    if (want > 1.0f) want = 1.0f;
+    // Within ~5% of the target time: leave it
+    if (fabsf(want - s_dyn.scale) < 0.025f * s_dyn.scale) return;
+
+    s_dyn.scale = want;
+    s_dyn.frames = -TIMER_FRAMES; // GPU times still in flight are from the old scale
+}
+
+static void dynres_shutdown(void) {
+    if (s_dyn.fbo) {
+        glDeleteFramebuffers(1, &s_dyn.fbo);
+        glDeleteRenderbuffers(1, &s_dyn.color);
+        glDeleteRenderbuffers(1, &s_dyn.depth);
+        MemTrackGpu(MEM_GPU_TEXTURES, -8ll * s_dyn.capW * s_dyn.capH);
+    }
+    MemFree(s_dyn.soft);
+    MemFree(s_dyn.xmap);
+    memset(&s_dyn, 0, sizeof s_dyn);
+}
+
+// Draw capture
+// BeginCapture records every frame's Begin2D..End2D calls into a compact
+// binary log: an 8-byte header, then per call a one-byte op followed by its
+// arguments as zigzag varints and colors as RGBA8 (exactly what the batches
+// keep, so a replay draws the same pixels). A frame is buffered and written
+// whole at End2D. Draws into render textures are left out, as are sprites
+// and text, whose texture contents the log does not carry.
+#define CAPTURE_MAGIC   "SBCAP"
+#define CAPTURE_VERSION 1
+
+enum {
+    CAP_BEGIN = 1,    // w h
+    CAP_END,
+    CAP_FLUSH,
+    CAP_RECT,         // x y w h rgba
+    CAP_RECT_SHAPE,   // x y w h rgba radii[4] borders[4]
+    CAP_RECTS,        // n, then n * (x y w h rgba)
+    CAP_LAYER,        // layer
+    CAP_SCISSOR,      // x y w h
+    CAP_SCISSOR_END,
+    CAP_NATIVE        // BeginNativeResolution
+};
+
+typedef struct Capture {
+    FILE* file;
+    bool inFrame;     // between a recorded Begin2D and End2D
+    int paused;       // public calls made by other public calls
+    unsigned char* buf;
+    size_t len, cap;
+} Capture;
+
+static Capture s_capture = {0};
+
+static inline bool capture_on(void) {
+    return s_capture.inFrame && !s_capture.paused && !s_rt.active;
+}
+
+static void capture_byte(unsigned char b) {
+    if (!s_capture.inFrame) return; // stopped mid-record
+    if (s_capture.len == s_capture.cap) {
+        const size_t newCap = s_capture.cap ? s_capture.cap * 2 : 4096;
+        unsigned char* buf = (unsigned char*)MemRealloc(MEM_DEBUG, s_capture.buf, newCap);
+        if (!buf) {
+            fprintf(stderr, "Out of memory capturing draws; capture stopped.\n");
+            EndCapture();
+            return;
+        }
+        s_capture.buf = buf;
+        s_capture.cap = newCap;
+    }
+    s_capture.buf[s_capture.len++] = b;
+}
+
+static void capture_int(int v) {
+    unsigned int z = ((unsigned int)v << 1) ^ (unsigned int)-(v < 0);
+    while (z >= 0x80) {
+        capture_byte((unsigned char)(z | 0x80));
+        z >>= 7;
+    }
+    capture_byte((unsigned char)z);
+}
+
+static void capture_color(Color c) {
+    capture_byte(unorm8(c.r));
+    capture_byte(unorm8(c.g));
+    capture_byte(unorm8(c.b));
+    capture_byte(unorm8(c.a));
+}
+
+static void capture_rect(unsigned char op, int x, int y, int w, int h) {
+    capture_byte(op);
+    capture_int(x);
+    capture_int(y);
+    capture_int(w);
+    capture_int(h);
+}
+
+static void capture_begin_frame(int w, int h) {
+    if (!s_capture.file) return;
+    s_capture.len = 0;
+    s_capture.inFrame = true;
+    capture_byte(CAP_BEGIN);
+    capture_int(w);
+    capture_int(h);
+}
+
+static void capture_end_frame(void) {
+    if (!s_capture.inFrame) return;
+    capture_byte(CAP_END);
+    if (!s_capture.file) return; // stopped by an allocation failure
+    s_capture.inFrame = false;
+    if (fwrite(s_capture.buf, 1, s_capture.len, s_capture.file) != s_capture.len) {
+        fprintf(stderr, "Failed writing draw capture; capture stopped.\n");
+        EndCapture();
+    }
+}
+
+struct CaptureReplay {
+    unsigned char* data;
+    size_t size, pos;
+    CaptureInfo info;
+    int* rects;       // CAP_RECTS scratch: x, y, w, h arrays of rectCap each
+    Color* colors;
+    size_t rectCap;
+};
+
+static bool replay_byte(CaptureReplay* r, unsigned char* b) {
+    if (r->pos >= r->size) return false;
+    *b = r->data[r->pos++];
+    return true;
+}
+
+static bool replay_int(CaptureReplay* r, int* v) {
+    unsigned int z = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        unsigned char b;
+        if (!replay_byte(r, &b)) return false;
+        z |= (unsigned int)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = (int)(z >> 1) ^ -(int)(z & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool replay_ints(CaptureReplay* r, int* v, int n) {
+    for (int i = 0; i < n; ++i) if (!replay_int(r, &v[i])) return false;
+    return true;
+}
+
+static bool replay_color(CaptureReplay* r, Color* c) {
+    unsigned char rgba[4];
+    for (int i = 0; i < 4; ++i) if (!replay_byte(r, &rgba[i])) return false;
+    *c = (Color){ rgba[0] / 255.0f, rgba[1] / 255.0f, rgba[2] / 255.0f, rgba[3] / 255.0f };
+    return true;
+}
+
+static bool replay_reserve_rects(CaptureReplay* r, size_t n) {
+    if (n <= r->rectCap) return true;
+    int* rects = (int*)MemRealloc(MEM_DEBUG, r->rects, n * 4 * sizeof *rects);
+    if (!rects) return false;
+    r->rects = rects;
+    Color* colors = (Color*)MemRealloc(MEM_DEBUG, r->colors, n * sizeof *colors);
+    if (!colors) return false;
+    r->colors = colors;
+    r->rectCap = n;
+    return true;
+}
+
+// Decodes one frame, issuing its calls when play is set; false on a
+// truncated or malformed record.
+static bool replay_frame(CaptureReplay* r, bool play) {
+    unsigned char op;
+    int a[12];
+    Color c;
+    if (!replay_byte(r, &op) || op != CAP_BEGIN || !replay_ints(r, a, 2)) return false;
+    if (a[0] < 0 || a[1] < 0 || a[0] > 32767 || a[1] > 32767) return false; // int16 pixel space
+    if (a[0] > r->info.width) r->info.width = a[0];
+    if (a[1] > r->info.height) r->info.height = a[1];
+    if (play) Begin2D(a[0], a[1]);
+
+    for (;;) {
+        if (!replay_byte(r, &op)) return false;
+        switch (op) {
+        case CAP_END:
+            if (play) End2D();
+            return true;
+        case CAP_FLUSH:
+            if (play) Flush2D();
+            break;
+        case CAP_RECT:
+            if (!replay_ints(r, a, 4) || !replay_color(r, &c)) return false;
+            if (play) DrawRectangle(a[0], a[1], a[2], a[3], c);
+            break;
+        case CAP_RECT_SHAPE:
+            if (!replay_ints(r, a, 4) || !replay_color(r, &c) || !replay_ints(r, a + 4, 8)) return false;
+            if (play) DrawRectangleBorder(a[0], a[1], a[2], a[3], (BorderWidths){ a[8], a[9], a[10], a[11] },
+                                          (CornerRadii){ a[4], a[5], a[6], a[7] }, c);
+            break;
+        case CAP_RECTS: {
+            if (!replay_int(r, &a[0]) || a[0] < 0) return false;
+            const size_t n = (size_t)a[0];
+            if (n > (r->size - r->pos) / 8) return false; // each rect takes at least 8 bytes
+            if (!replay_reserve_rects(r, n)) {
+                fprintf(stderr, "Out of memory replaying draw capture.\n");
+                return false;
+            }
+            int* xs = r->rects;
+            int* ys = xs + r->rectCap;
+            int* ws = ys + r->rectCap;
+            int* hs = ws + r->rectCap;
+            for (size_t i = 0; i < n; ++i) {
+                if (!replay_ints(r, a, 4) || !replay_color(r, &r->colors[i])) return false;
+                xs[i] = a[0]; ys[i] = a[1]; ws[i] = a[2]; hs[i] = a[3];
+            }
+            if (play) DrawRectangles(xs, ys, ws, hs, r->colors, n);
+            break;
+        }
+        case CAP_LAYER:
+            if (!replay_int(r, &a[0])) return false;
+            if (play) SetDrawLayer(a[0]);
+            break;
+        case CAP_SCISSOR:
+            if (!replay_ints(r, a, 4)) return false;
+            if (play) BeginScissor(a[0], a[1], a[2], a[3]);
+            break;
+        case CAP_SCISSOR_END:
+            if (play) EndScissor();
+            break;
+        case CAP_NATIVE:
+            if (play) BeginNativeResolution();
+            break;
+        default:
+            return false;
+        }
+    }
+}
+
+// Public API
+void RendererInit(void) {
+    s_glReady = s_backend == RENDER_BACKEND_GL;
+    if (s_glReady) {
+        glstate_reset();
+        unit_quad_init();
+        quad_indices_init();
+        rectbatch_init(2048);
+        texbatch_init(2048);
+    }
+    queue_init(4096);
+    clip_init();
+    s_fbW = s_fbH = 0;
+    s_viewUniforms = (ViewUniforms){0};
+}
+
+void RendererShutdown(void) {
+    EndCapture();
+    if (s_rt.active) EndTextureMode();
+    rendertarget_shutdown();
+    dynres_shutdown();
+    upload_shutdown();
+    timer_shutdown();
+    queue_shutdown();
+    clip_shutdown();
+    texbatch_shutdown();
+    rectbatch_shutdown();
+    if (s_unitQuadVbo) MemTrackGpu(MEM_GPU_BUFFERS, -(long long)sizeof s_unitQuad);
+    if (s_quadIbo) MemTrackGpu(MEM_GPU_BUFFERS, -(long long)QUAD_INDEX_BYTES);
+    gl_delete_buffer(&s_unitQuadVbo);
+    gl_delete_buffer(&s_quadIbo);
+    glstate_reset();
+    soft_shutdown();
+    UnloadFonts(); // glyph textures went with the texture array
+    ReleaseClayCache(); // and so did cached element textures
+    s_glReady = false;
+}
+
+void Begin2D(int fbWidth, int fbHeight) {
+    capture_begin_frame(fbWidth, fbHeight);
+    s_timer.cur = (FrameStats){0};
+    s_timer.frameStart = GetTime();
+    s_timer.glIssued = s_gl.issued;
+    s_timer.glSkipped = s_gl.skipped;
+    const bool resized = fbWidth != s_fbW || fbHeight != s_fbH;
+    if (resized) {
+        s_fbW = fbWidth;
+        s_fbH = fbHeight;
+        queue_resize_grid(fbWidth, fbHeight);
+    }
+    if (s_glReady) upload_retire();
+    if (s_backend == RENDER_BACKEND_SOFTWARE) {
+        dynres_begin(fbWidth, fbHeight);
+        frame_viewport();
+        return;
+    }
+
+    gl_enable(GL_DEPTH_TEST, false);
+    gl_depth_mask(true);
+    gl_enable(GL_CULL_FACE, false);
+    gl_enable(GL_SCISSOR_TEST, false);
+    for (int i = 0; i < 4; ++i) gl_enable(GL_CLIP_DISTANCE0 + i, true);
+    gl_enable(GL_BLEND, true);
+    gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    dynres_begin(fbWidth, fbHeight); // after the scissor test is off: it clips blits
+    frame_viewport();
+
+    if (s_depthPass.enabled) {
+        static bool warned = false;
+        s_depthPass.available = framebuffer_has_depth();
+        if (!s_depthPass.available && !warned) {
+            fprintf(stderr, "Opaque depth pass needs a depth buffer; drawing in order.\n");
+            warned = true;
+        }
+    }
+}
+
+
+void End2D(void) {
+    PROFILE_BEGIN("End2D");
+    if (s_rt.active) EndTextureMode();
+    capture_end_frame();
+    dynres_resolve();
+    queue_emit();
+    if (s_glReady) upload_pump();
+    ring_advance(&s_rectBatch.ring);
+    ring_advance(&s_texBatch.ring);
+    s_queue.layer = 0;
+    s_clip.depth = 0;
+    clip_reset_table();
+
+    FrameStats* f = &s_timer.cur;
+    f->cpuMs = (GetTime() - s_timer.frameStart) * 1e3;
+    f->glCallsIssued = (unsigned int)(s_gl.issued - s_timer.glIssued);
+    f->glCallsSkipped = (unsigned int)(s_gl.skipped - s_timer.glSkipped);
+    s_timer.slot = (s_timer.slot + 1) % TIMER_FRAMES;
+    timer_resolve(&s_timer.slots[s_timer.slot]);
+    f->gpuMs = s_timer.gpuMs;
+    s_timer.last = *f;
+    dynres_update(f->cpuMs > f->gpuMs ? f->cpuMs : f->gpuMs);
+    AdvanceFrameArena();
+    PROFILE_END();
+}
+
+void Flush2D(void) {
+    if (capture_on()) capture_byte(CAP_FLUSH);
+    queue_emit();
+}
+
+void SetDynamicResolution(bool enabled, double targetMs, float minScale) {
+    if (minScale < 0.1f) minScale = 0.1f;
+    if (minScale > 1.0f) minScale = 1.0f;
+    s_dyn.enabled = enabled && targetMs > 0.0;
+    s_dyn.targetMs = targetMs;
+    s_dyn.minScale = minScale;
+    if (!s_dyn.enabled || s_dyn.scale <= 0.0f) s_dyn.scale = 1.0f;
+    if (s_dyn.scale < minScale) s_dyn.scale = minScale;
+    s_dyn.frames = 0;
+}
+
+float GetResolutionScale(void) {
+    return s_dyn.active ? s_dyn.frameScale : 1.0f;
+}
+
+void BeginNativeResolution(void) {
+    if (s_rt.active) {
+        fprintf(stderr, "BeginNativeResolution: call EndTextureMode first.\n");
+        return;
+    }
+    if (capture_on()) capture_byte(CAP_NATIVE);
+    dynres_resolve();
+}
+
+void SetDrawLayer(int layer) {
+    if (capture_on()) {
+        capture_byte(CAP_LAYER);
+        capture_int(layer);
+    }
+    if (layer < 0) layer = 0;
+    if (layer > 255) layer = 255;
+    if ((unsigned int)layer == s_queue.layer) return;
+    // The grid keeps its history: a layer entered again must still see what
+    // it drew before, and history from other layers only raises depths
+    s_queue.layer = (unsigned int)layer;
+}
+
+StreamRingStats GetStreamRingStats(void) {
+    StreamRingStats st = s_ringStats;
+    st.ringBytes = (s_rectBatch.ring.regionBytes + s_texBatch.ring.regionBytes) * RING_REGIONS;
+    return st;
+}
+
+void ResetStreamRingStats(void) {
+    memset(&s_ringStats, 0, sizeof s_ringStats);
+}
+
+FrameStats GetFrameStats(void) {
+    return s_timer.last;
+}
+
+void ResetGLStateCache(void) {
+    glstate_reset();
+}
+
+void BeginScissor(int x, int y, int w, int h) {
+    if (capture_on()) capture_rect(CAP_SCISSOR, x, y, w, h);
+    if (s_clip.depth == CLIP_STACK_MAX) {
+        fprintf(stderr, "Clip stack overflow (%d levels).\n", CLIP_STACK_MAX);
+        return;
+    }
+    if (s_clip.count >= CLIP_TABLE_MAX) {
+        queue_emit();          // draw with the full table, then start a new one
+        clip_reset_table();
+    }
+    if (w < 0) { x += w; w = -w; }
+    if (h < 0) { y += h; h = -h; }
+    ClipRect r = { clamp_i16(x), clamp_i16(y), clamp_i16((long)x + w), clamp_i16((long)y + h) };
+    if (s_clip.depth) r = clip_intersect(r, s_clip.stackRect[s_clip.depth - 1]);
+
+    s_clip.stackRect[s_clip.depth] = r;
+    s_clip.stackId[s_clip.depth] = clip_register(r);
+    s_clip.depth++;
+}
+
+void EndScissor(void) {
+    if (capture_on()) capture_byte(CAP_SCISSOR_END);
+    if (s_clip.depth > 0) s_clip.depth--;
+}
+
+void SetRectBatchMode(RectBatchMode mode) {
+    if (mode == s_rectBatch.mode) return;
+    queue_emit();
+    s_rectBatch.mode = mode;
+}
+
+void SetOpaqueDepthPass(bool enabled) {
+    if (enabled == s_depthPass.enabled) return;
+    queue_emit();
+    s_depthPass.enabled = enabled;
+    s_depthPass.available = enabled && s_glReady && framebuffer_has_depth();
+}
+
+void SetRenderBackend(RenderBackend backend) {
+    if (backend == s_backend) return;
+    if (backend == RENDER_BACKEND_GL && s_queue.cmds && !s_glReady) {
+        fprintf(stderr, "GL backend unavailable: the renderer was initialised for software only.\n");
+        return;
+    }
+    queue_emit();
+    s_backend = backend;
+    if (backend == RENDER_BACKEND_SOFTWARE) s_soft.keepPixels = true;
+    s_fbW = s_fbH = 0; // the next Begin2D re-sends size-dependent state
+}
+
+RenderBackend GetRenderBackend(void) {
+    return s_backend;
+}
+
+void SetSoftwareTarget(unsigned char* rgba, int width, int height, int strideBytes) {
+    queue_emit();
+    const bool valid = rgba && width > 0 && height > 0;
+    s_soft.target = valid ? rgba : NULL;
+    s_soft.width  = valid ? width : 0;
+    s_soft.height = valid ? height : 0;
+    s_soft.stride = valid ? (size_t)(strideBytes > 0 ? strideBytes : width * 4) : 0;
+}
+
+void ClearSoftwareTarget(Color c) {
+    if (!s_soft.target) return;
+    const unsigned char col[4] = { unorm8(c.r), unorm8(c.g), unorm8(c.b), unorm8(c.a) };
+    for (int y = 0; y < s_soft.height; ++y)
+        soft_fill_span((uint32_t*)(s_soft.target + (size_t)y * s_soft.stride), s_soft.width, soft_pack(col));
+}
+
+void DrawRectangle(int x, int y, int w, int h, Color c) {
+    if (capture_on()) {
+        capture_rect(CAP_RECT, x, y, w, h);
+        capture_color(c);
+    }
+    queue_push(PIPE_RECT, 0, x, y, w, h, c, 0, s_flatShape);
+}
+
+// Rects per DrawRectangles batch; bounds the staging growth for huge calls
+#define RECT_BULK_CHUNK 65536
+
+void DrawRectangles(const int* x, const int* y, const int* w, const int* h, const Color* colors, size_t count) {
+    if (count == 0 || s_fbW <= 0 || s_fbH <= 0) return;
+    if (capture_on() && count <= INT32_MAX) {
+        capture_byte(CAP_RECTS);
+        capture_int((int)count);
+        for (size_t i = 0; i < count; ++i) {
+            capture_int(x[i]);
+            capture_int(y[i]);
+            capture_int(w[i]);
+            capture_int(h[i]);
+            capture_color(colors[i]);
+        }
+    }
+
+    // The software backend and the indexed path take the queued route
+    if (s_backend == RENDER_BACKEND_SOFTWARE || s_rectBatch.mode != RECT_BATCH_INSTANCED) {
+        s_capture.paused++;
+        for (size_t i = 0; i < count; ++i) DrawRectangle(x[i], y[i], w[i], h[i], colors[i]);
+        s_capture.paused--;
+        return;
+    }
+
+    // Everything queued so far draws first, so the whole call is one
+    // unsorted run of instances on top of it.
+    queue_emit();
+    const unsigned short clip = clip_current();
+    clip_upload();
+
+    const size_t chunk = count < RECT_BULK_CHUNK ? count : RECT_BULK_CHUNK;
+    if (!rectbatch_grow_instances(chunk)) return; // OOM guard
+
+    for (size_t i = 0; i < count; i += chunk) {
+        const size_t n = count - i < chunk ? count - i : chunk;
+        rect_pack_instances(s_rectBatch.instData, x + i, y + i, w + i, h + i, colors + i, n, clip);
+        s_rectBatch.countQuads = n;
+        pipeline_flush(PIPE_RECT);
+    }
+}
+
+static inline unsigned char clamp_u8(int v, int hi) {
+    if (hi > 255) hi = 255;
+    if (v > hi) v = hi;
+    return (unsigned char)(v < 0 ? 0 : v);
+}
+
+void DrawRectangleRounded(int x, int y, int w, int h, CornerRadii radius, Color c) {
+    DrawRectangleBorder(x, y, w, h, (BorderWidths){0}, radius, c);
+}
+
+void DrawRectangleBorder(int x, int y, int w, int h, BorderWidths widths, CornerRadii radius, Color c) {
+    if (capture_on()) {
+        capture_rect(CAP_RECT_SHAPE, x, y, w, h);
+        capture_color(c);
+        capture_int(radius.topLeft);
+        capture_int(radius.topRight);
+        capture_int(radius.bottomLeft);
+        capture_int(radius.bottomRight);
+        capture_int(widths.left);
+        capture_int(widths.right);
+        capture_int(widths.top);
+        capture_int(widths.bottom);
+    }
+    const int aw = w < 0 ? -w : w, ah = h < 0 ? -h : h;
+    const int rmax = (aw < ah ? aw : ah) / 2;
+    const RectShape shape = {
+        { clamp_u8(radius.topLeft, rmax), clamp_u8(radius.topRight, rmax),
+          clamp_u8(radius.bottomLeft, rmax), clamp_u8(radius.bottomRight, rmax) },
+        { clamp_u8(widths.left, aw), clamp_u8(widths.right, aw),
+          clamp_u8(widths.top, ah), clamp_u8(widths.bottom, ah) }
+    };
+    queue_push(PIPE_RECT, 0, x, y, w, h, c, 0, shape);
+}
+
+static Texture texture_load(const unsigned char* rgba, int width, int height, bool async) {
+    Texture t = {0};
+    if (!rgba || width <= 0 || height <= 0) return t;
+    if (width > TEX_LAYER_SIZE - TEX_PAD || height > TEX_LAYER_SIZE - TEX_PAD) {
+        fprintf(stderr, "Texture %dx%d exceeds the %d px array layer.\n", width, height, TEX_LAYER_SIZE);
+        return t;
+    }
+
+    if (s_texBatch.imageCount == 0) s_texBatch.imageCount = 1; // id 0 is the invalid handle
+    if (!s_texBatch.freeIdCount && s_texBatch.imageCount >= s_texBatch.imageCap) {
+        size_t newCap = s_texBatch.imageCap ? s_texBatch.imageCap * 2 : 64;
+        TexImage* newImgs = (TexImage*)MemRealloc(MEM_TEXTURES, s_texBatch.images, newCap * sizeof(TexImage));
+        if (!newImgs) {
+            fprintf(stderr, "Out of memory loading texture.\n");
+            return t;
+        }
+        s_texBatch.images = newImgs;
+        s_texBatch.imageCap = newCap;
+    }
+
+    TexImage img = { 0, 0, 0, (unsigned short)width, (unsigned short)height,
+                     (unsigned short)width, (unsigned short)height, 0, 0, 0 };
+    if (s_glReady) {
+        if (!texarray_alloc(width, height, &img)) return t;
+
+        if (!async) {
+            gl_bind_texture(0, GLS_TEX_2D_ARRAY, s_texBatch.tex);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, img.x, img.y, img.layer, width, height, 1,
+                            GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        }
+    }
+    t.id = s_texBatch.freeIdCount ? s_texBatch.freeIds[--s_texBatch.freeIdCount]
+                                  : (unsigned int)s_texBatch.imageCount++;
+    if (s_soft.keepPixels) soft_keep_pixels(t.id, rgba, width, height);
+    s_texBatch.images[t.id] = img;
+    t.width = width;
+    t.height = height;
+    if (s_glReady && async) upload_enqueue(t.id, rgba);
+    return t;
+}
+
+Texture LoadTextureFromPixels(const unsigned char* rgba, int width, int height) {
+    return texture_load(rgba, width, height, false);
+}
+
+Texture LoadTextureFromPixelsAsync(const unsigned char* rgba, int width, int height) {
+    return texture_load(rgba, width, height, true);
+}
+
+bool IsTextureReady(Texture t) {
+    return t.id != 0 && t.id < s_texBatch.imageCount && s_texBatch.images[t.id].capW &&
+           s_texBatch.images[t.id].pending == 0;
+}
+
+// Frees image id's region, CPU copy and slot for reuse.
+static void texture_release(unsigned int id) {
+    TexImage* img = &s_texBatch.images[id];
+    if (s_glReady) texarray_free(img);
+    if (id < s_soft.pixelsCap) {
+        MemFree(s_soft.pixels[id]);
+        s_soft.pixels[id] = NULL;
+    }
+    *img = (TexImage){0};
+    if (s_texBatch.freeIdCount == s_texBatch.freeIdCap) {
+        const size_t newCap = s_texBatch.freeIdCap ? s_texBatch.freeIdCap * 2 : 64;
+        unsigned int* ids = (unsigned int*)MemRealloc(MEM_TEXTURES, s_texBatch.freeIds, newCap * sizeof *ids);
+        if (!ids) return; // the slot stays unused
+        s_texBatch.freeIds = ids;
+        s_texBatch.freeIdCap = newCap;
+    }
+    s_texBatch.freeIds[s_texBatch.freeIdCount++] = id;
+}
+
+void UnloadTexture(Texture t) {
+    if (t.id == 0 || t.id >= s_texBatch.imageCount) return;
+    TexImage* img = &s_texBatch.images[t.id];
+    if (!img->capW || img->unloading) return;
+    if (s_rt.active && s_rt.id == t.id) {
+        fprintf(stderr, "UnloadTexture: texture is the current render target.\n");
+        return;
+    }
+    if (s_queue.count) queue_emit(); // queued draws may use it
+
+    // Rows still waiting for staging space are dropped; rows already staged
+    // hold the slot until their buffer retires.
+    for (size_t i = 0; i < s_upload.jobCount; ++i) {
+        if (s_upload.jobs[i].id != t.id) continue;
+        MemFree(s_upload.jobs[i].pixels);
+        memmove(s_upload.jobs + i, s_upload.jobs + i + 1, (s_upload.jobCount - i - 1) * sizeof *s_upload.jobs);
+        s_upload.jobCount--;
+        img->pending--;
+        break;
+    }
+    if (img->pending) img->unloading = 1;
+    else texture_release(t.id);
+}
+
+Texture LoadTexture(const char* path) {
+    int w = 0, h = 0, n = 0;
+    unsigned char* pixels = stbi_load(path, &w, &h, &n, 4);
+    if (!pixels) {
+        fprintf(stderr, "Failed to load image %s: %s\n", path, stbi_failure_reason());
+        return (Texture){0};
+    }
+    Texture t = LoadTextureFromPixels(pixels, w, h);
+    stbi_image_free(pixels);
+    return t;
+}
+
+Texture LoadTextureAsync(const char* path) {
+    int w = 0, h = 0, n = 0;
+    unsigned char* pixels = stbi_load(path, &w, &h, &n, 4);
+    if (!pixels) {
+        fprintf(stderr, "Failed to load image %s: %s\n", path, stbi_failure_reason());
+        return (Texture){0};
+    }
+    Texture t = LoadTextureFromPixelsAsync(pixels, w, h);
+    stbi_image_free(pixels);
+    return t;
+}
+
+void DrawTexture(Texture t, int x, int y, Color tint) {
+    const TexImage* img = texbatch_image(t);
+    if (img) queue_push(PIPE_SPRITE, 0, x, y, img->w, img->h, tint, t.id, s_flatShape);
+}
+
+void DrawTextureRect(Texture t, int x, int y, int w, int h, Color tint) {
+    if (texbatch_image(t)) queue_push(PIPE_SPRITE, 0, x, y, w, h, tint, t.id, s_flatShape);
+}
+
+static const TexImage* render_texture_image(Texture t, const char* what) {
+    const TexImage* img = texbatch_image(t);
+    if (!img || !(img->flags & SPRITE_PREMULTIPLIED)) {
+        fprintf(stderr, "%s needs a texture from LoadRenderTexture.\n", what);
+        return NULL;
+    }
+    return img;
+}
+
+Texture LoadRenderTexture(int width, int height) {
+    if (width <= 0 || height <= 0) return (Texture){0};
+    unsigned char* zero = (unsigned char*)MemCalloc(MEM_TEXTURES, (size_t)width * height, 4);
+    if (!zero) {
+        fprintf(stderr, "Out of memory creating render texture.\n");
+        return (Texture){0};
+    }
+    Texture t = LoadTextureFromPixels(zero, width, height);
+    MemFree(zero);
+    if (t.id) s_texBatch.images[t.id].flags = SPRITE_PREMULTIPLIED;
+    return t;
+}
+
+bool ResizeRenderTexture(Texture* t, int width, int height) {
+    if (!t || !render_texture_image(*t, "ResizeRenderTexture")) return false;
+    if (s_rt.active && s_rt.id == t->id) {
+        fprintf(stderr, "ResizeRenderTexture: texture is the current render target.\n");
+        return false;
+    }
+    if (width <= 0 || height <= 0) return false;
+    if (width > TEX_LAYER_SIZE - TEX_PAD || height > TEX_LAYER_SIZE - TEX_PAD) {
+        fprintf(stderr, "Texture %dx%d exceeds the %d px array layer.\n", width, height, TEX_LAYER_SIZE);
+        return false;
+    }
+    TexImage* img = &s_texBatch.images[t->id];
+    if (width == img->w && height == img->h) return true;
+
+    queue_emit(); // queued draws of t use the old size
+    if (width > img->capW || height > img->capH) {
+        // Round up so a region that keeps growing moves rarely. The old
+        // region goes back to the packer once the new one is placed.
+        const int lim = TEX_LAYER_SIZE - TEX_PAD;
+        int cw = (width > img->capW ? width : img->capW) + RENDER_TEXTURE_ALIGN - 1;
+        int ch = (height > img->capH ? height : img->capH) + RENDER_TEXTURE_ALIGN - 1;
+        cw -= cw % RENDER_TEXTURE_ALIGN;
+        ch -= ch % RENDER_TEXTURE_ALIGN;
+        if (cw > lim) cw = lim;
+        if (ch > lim) ch = lim;
+
+        TexImage moved = { img->layer, img->x, img->y, img->w, img->h,
+                           (unsigned short)cw, (unsigned short)ch, img->flags, 0, 0 };
+        if (s_glReady) {
+            if (!texarray_alloc(cw, ch, &moved)) return false;
+            moved.flags = img->flags;
+            texarray_free(img);
+        }
+        *img = moved;
+    }
+    img->w = (unsigned short)width;
+    img->h = (unsigned short)height;
+    if (s_soft.keepPixels) {
+        unsigned char* zero = (unsigned char*)MemCalloc(MEM_TEXTURES, (size_t)width * height, 4);
+        if (zero) soft_keep_pixels(t->id, zero, width, height);
+        MemFree(zero);
+    }
+    t->width = width;
+    t->height = height;
+    return true;
+}
+
+void BeginTextureMode(Texture target) {
+    if (s_rt.active) {
+        fprintf(stderr, "BeginTextureMode: already rendering to a texture.\n");
+        return;
+    }
+    if (s_fbW <= 0 || s_fbH <= 0) {
+        fprintf(stderr, "BeginTextureMode must be called between Begin2D and End2D.\n");
+        return;
+    }
+    const TexImage* img = render_texture_image(target, "BeginTextureMode");
+    if (!img) return;
+    const int w = img->w, h = img->h;
+
+    queue_emit();
+    if (s_backend == RENDER_BACKEND_SOFTWARE) {
+        unsigned char* buf = (unsigned char*)MemCalloc(MEM_RENDERER, (size_t)w * h, 4);
+        if (!buf) {
+            fprintf(stderr, "Out of memory rendering to texture.\n");
+            return;
+        }
+        s_rt.prevSoft = s_soft.target;
+        s_rt.prevSoftW = s_soft.width;
+        s_rt.prevSoftH = s_soft.height;
+        s_rt.prevSoftStride = s_soft.stride;
+        s_soft.target = buf;
+        s_soft.width = w;
+        s_soft.height = h;
+        s_soft.stride = (size_t)w * 4;
+        s_soft.alphaOver = true;
+        s_soft.scale = 1.0f; // textures render at full resolution
+    } else {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &s_rt.prevFbo);
+        if (!rendertarget_reserve(w, h)) {
+            glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)s_rt.prevFbo);
+            return;
+        }
+        gl_viewport(0, 0, w, h);
+        set_viewport_uniforms(w, h, 1.0f);
+        const GLfloat clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, clear);
+        gl_blend_func_separate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    s_rt.active = true;
+    s_rt.id = target.id;
+    s_rt.prevDepthAvail = s_depthPass.available;
+    s_depthPass.available = false; // the scratch target has no depth buffer
+    s_rt.prevW = s_fbW;
+    s_rt.prevH = s_fbH;
+    s_fbW = w;
+    s_fbH = h;
+    queue_resize_grid(w, h);
+    s_rt.prevLayer = s_queue.layer;
+    s_queue.layer = 0;
+
+    // Scissors inside the target start from an unclipped entry above the
+    // frame's stack, which EndTextureMode pops back to.
+    s_rt.prevClipDepth = s_clip.depth;
+    if (s_clip.depth < CLIP_STACK_MAX) {
+        s_clip.stackRect[s_clip.depth] = (ClipRect){ -32768, -32768, 32767, 32767 };
+        s_clip.stackId[s_clip.depth] = 0;
+        s_clip.depth++;
+    }
+}
+
+void EndTextureMode(void) {
+    if (!s_rt.active) return;
+    queue_emit();
+
+    const TexImage* img = &s_texBatch.images[s_rt.id];
+    const int w = s_fbW, h = s_fbH;
+    if (s_backend == RENDER_BACKEND_SOFTWARE) {
+        soft_keep_pixels(s_rt.id, s_soft.target, w, h);
+        MemFree(s_soft.target);
+        s_soft.target = s_rt.prevSoft;
+        s_soft.width = s_rt.prevSoftW;
+        s_soft.height = s_rt.prevSoftH;
+        s_soft.stride = s_rt.prevSoftStride;
+        s_soft.alphaOver = false;
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, s_rt.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, s_rt.blitFbo);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, s_texBatch.tex, 0, img->layer);
+        glBlitFramebuffer(0, 0, w, h, img->x, img->y + h, img->x + w, img->y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)s_rt.prevFbo);
+        gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    s_depthPass.available = s_rt.prevDepthAvail;
+    s_fbW = s_rt.prevW;
+    s_fbH = s_rt.prevH;
+    queue_resize_grid(s_fbW, s_fbH);
+    frame_viewport();
+    s_queue.layer = s_rt.prevLayer;
+    s_clip.depth = s_rt.prevClipDepth;
+    s_rt.active = false;
+}
+
+bool BeginCapture(const char* path) {
+    EndCapture();
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Failed to open capture file %s.\n", path);
+        return false;
+    }
+    const unsigned char header[8] = { 'S', 'B', 'C', 'A', 'P', 0, CAPTURE_VERSION, 0 };
+    if (fwrite(header, 1, sizeof header, f) != sizeof header) {
+        fprintf(stderr, "Failed writing capture file %s.\n", path);
+        fclose(f);
+        return false;
+    }
+    s_capture.file = f;
+    return true;
+}
+
+void EndCapture(void) {
+    if (s_capture.file) fclose(s_capture.file);
+    MemFree(s_capture.buf);
+    s_capture = (Capture){ .paused = s_capture.paused };
+}
+
+bool IsCapturing(void) {
+    return s_capture.file != NULL;
+}
+
+CaptureReplay* LoadCapture(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open capture file %s.\n", path);
+        return NULL;
+    }
+    CaptureReplay* r = (CaptureReplay*)MemCalloc(MEM_DEBUG, 1, sizeof *r);
+    long size = -1;
+    if (r && fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+    if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) r->data = (unsigned char*)MemAlloc(MEM_DEBUG, size ? (size_t)size : 1);
+    if (!r || !r->data || fread(r->data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "Failed reading capture file %s.\n", path);
+        fclose(f);
+        UnloadCapture(r);
+        return NULL;
+    }
+    fclose(f);
+    r->size = (size_t)size;
+
+    if (r->size < 8 || memcmp(r->data, CAPTURE_MAGIC, 6) != 0 || r->data[6] != CAPTURE_VERSION) {
+        fprintf(stderr, "%s is not a version %d draw capture.\n", path, CAPTURE_VERSION);
+        UnloadCapture(r);
+        return NULL;
+    }
+    // Validate every frame up front so playback never stops partway
+    r->pos = 8;
+    while (r->pos < r->size) {
+        if (!replay_frame(r, false)) {
+            fprintf(stderr, "Draw capture %s is corrupt at byte %zu.\n", path, r->pos);
+            UnloadCapture(r);
+            return NULL;
+        }
+        r->info.frames++;
+    }
+    r->pos = 8;
+    return r;
+}
+
+void UnloadCapture(CaptureReplay* r) {
+    if (!r) return;
+    MemFree(r->data);
+    MemFree(r->rects);
+    MemFree(r->colors);
+    MemFree(r);
+}
+
+CaptureInfo GetCaptureInfo(const CaptureReplay* r) {
+    return r ? r->info : (CaptureInfo){0};
+}
+
+bool ReplayCaptureFrame(CaptureReplay* r) {
+    if (!r || r->pos >= r->size) return false;
+    return replay_frame(r, true);
+}
+
+void RewindCapture(CaptureReplay* r) {
+    if (r) r->pos = 8;
+}
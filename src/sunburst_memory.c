@@ -0,0 +1,303 @@
+#include "sunburst.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+
+// Tracking allocator
+// Every block carries a MEM_HEADER-byte prefix recording its size and tag, so
+// MemFree and MemRealloc can settle the owning tag's counters without the
+// caller passing either back. Counters are atomic because the profiler
+// allocates from whichever thread first opens a zone.
+#define MEM_HEADER 16 // keeps malloc's 16-byte alignment for the caller
+
+typedef struct MemBlock {
+    size_t size;
+    MemTag tag;
+} MemBlock;
+
+typedef struct MemCounters {
+    long long live, peak, allocs, frees, failed, budget;
+} MemCounters;
+
+#if defined(_MSC_VER)
+  #include <windows.h>
+  #define mem_add(p, v) (InterlockedExchangeAdd64((volatile LONG64*)(p), (v)) + (v))
+  #define mem_load(p)   InterlockedCompareExchange64((volatile LONG64*)(p), 0, 0)
+  #define mem_store(p, v) InterlockedExchange64((volatile LONG64*)(p), (v))
+  #define mem_cas(p, expect, v) \
+      (InterlockedCompareExchange64((volatile LONG64*)(p), (v), (expect)) == (expect))
+#else
+  #define mem_add(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+  #define mem_load(p)   __atomic_load_n((p), __ATOMIC_RELAXED)
+  #define mem_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+  #define mem_cas(p, expect, v) \
+      __atomic_compare_exchange_n((p), &(long long){ (expect) }, (v), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#endif
+
+static MemCounters s_mem[MEM_TAG_COUNT];
+
+static const char* const s_memTagNames[MEM_TAG_COUNT] = {
+    "general", "renderer", "textures", "text", "ui", "frame", "debug", "gpu_buffers", "gpu_textures"
+};
+
+static bool mem_valid_tag(MemTag tag) {
+    return (unsigned)tag < MEM_TAG_COUNT;
+}
+
+// Sizes the signed counters (and the header) can't hold
+static bool mem_too_big(size_t bytes) {
+    return bytes > (size_t)LLONG_MAX - MEM_HEADER;
+}
+
+static void mem_raise_peak(MemCounters* c, long long live) {
+    long long peak = mem_load(&c->peak);
+    while (live > peak && !mem_cas(&c->peak, peak, live)) peak = mem_load(&c->peak);
+}
+
+// Charges bytes to tag, refusing (and counting the refusal) past its budget
+static bool mem_charge(MemTag tag, size_t bytes) {
+    MemCounters* c = &s_mem[tag];
+    const long long live = mem_add(&c->live, (long long)bytes);
+    const long long budget = mem_load(&c->budget);
+    if (budget > 0 && live > budget) {
+        mem_add(&c->live, -(long long)bytes);
+        mem_add(&c->failed, 1);
+        return false;
+    }
+    mem_raise_peak(c, live);
+    return true;
+}
+
+void* MemAlloc(MemTag tag, size_t bytes) {
+    if (!mem_valid_tag(tag)) tag = MEM_GENERAL;
+    if (mem_too_big(bytes)) {
+        mem_add(&s_mem[tag].failed, 1);
+        return NULL;
+    }
+    if (!mem_charge(tag, bytes)) return NULL;
+    MemBlock* b = (MemBlock*)malloc(MEM_HEADER + bytes);
+    if (!b) {
+        mem_add(&s_mem[tag].live, -(long long)bytes);
+        mem_add(&s_mem[tag].failed, 1);
+        return NULL;
+    }
+    b->size = bytes;
+    b->tag = tag;
+    mem_add(&s_mem[tag].allocs, 1);
+    return (unsigned char*)b + MEM_HEADER;
+}
+
+void* MemCalloc(MemTag tag, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return MemAlloc(tag, SIZE_MAX); // counted as failed
+    void* p = MemAlloc(tag, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+void* MemRealloc(MemTag tag, void* p, size_t bytes) {
+    if (!p) return MemAlloc(tag, bytes);
+    MemBlock* b = (MemBlock*)((unsigned char*)p - MEM_HEADER);
+    const size_t old = b->size;
+    tag = b->tag; // the block stays with the tag it was allocated under
+    if (mem_too_big(bytes)) {
+        mem_add(&s_mem[tag].failed, 1);
+        return NULL;
+    }
+    if (bytes > old && !mem_charge(tag, bytes - old)) return NULL;
+
+    MemBlock* nb = (MemBlock*)realloc(b, MEM_HEADER + bytes);
+    if (!nb) {
+        if (bytes > old) mem_add(&s_mem[tag].live, -(long long)(bytes - old));
+        mem_add(&s_mem[tag].failed, 1);
+        return NULL; // p is untouched, as with realloc
+    }
+    if (bytes < old) mem_add(&s_mem[tag].live, -(long long)(old - bytes));
+    nb->size = bytes;
+    return (unsigned char*)nb + MEM_HEADER;
+}
+
+void MemFree(void* p) {
+    if (!p) return;
+    MemBlock* b = (MemBlock*)((unsigned char*)p - MEM_HEADER);
+    mem_add(&s_mem[b->tag].live, -(long long)b->size);
+    mem_add(&s_mem[b->tag].frees, 1);
+    free(b);
+}
+
+bool MemTrackGpu(MemTag tag, long long deltaBytes) {
+    if (!mem_valid_tag(tag) || deltaBytes == 0) return true;
+    if (deltaBytes > 0) {
+        if (!mem_charge(tag, (size_t)deltaBytes)) return false;
+        mem_add(&s_mem[tag].allocs, 1);
+    } else {
+        mem_add(&s_mem[tag].live, deltaBytes);
+        mem_add(&s_mem[tag].frees, 1);
+    }
+    return true;
+}
+
+void SetMemBudget(MemTag tag, size_t bytes) {
+    if (!mem_valid_tag(tag)) return;
+    mem_store(&s_mem[tag].budget, bytes > (size_t)LLONG_MAX ? LLONG_MAX : (long long)bytes);
+}
+
+MemStats GetMemStats(MemTag tag) {
+    if (!mem_valid_tag(tag)) return (MemStats){0};
+    MemCounters* c = &s_mem[tag];
+    const long long live = mem_load(&c->live);
+    return (MemStats){
+        .liveBytes = live > 0 ? (size_t)live : 0,
+        .peakBytes = (size_t)mem_load(&c->peak),
+        .allocs    = (unsigned long long)mem_load(&c->allocs),
+        .frees     = (unsigned long long)mem_load(&c->frees),
+        .failed    = (unsigned long long)mem_load(&c->failed),
+        .budget    = (size_t)mem_load(&c->budget),
+    };
+}
+
+MemStats GetMemTotals(bool gpu) {
+    MemStats t = {0};
+    const MemTag first = gpu ? MEM_GPU_BUFFERS : MEM_GENERAL;
+    const MemTag last  = gpu ? MEM_TAG_COUNT : MEM_GPU_BUFFERS;
+    for (MemTag tag = first; tag < last; ++tag) {
+        const MemStats s = GetMemStats(tag);
+        t.liveBytes += s.liveBytes;
+        t.peakBytes += s.peakBytes; // sum of per-tag peaks: an upper bound
+        t.allocs    += s.allocs;
+        t.frees     += s.frees;
+        t.failed    += s.failed;
+    }
+    return t;
+}
+
+void ResetMemPeaks(void) {
+    for (int i = 0; i < MEM_TAG_COUNT; ++i) mem_store(&s_mem[i].peak, mem_load(&s_mem[i].live));
+}
+
+const char* GetMemTagName(MemTag tag) {
+    return mem_valid_tag(tag) ? s_memTagNames[tag] : "unknown";
+}
+
+
+// Arenas
+// An arena is a chain of blocks bump-allocated front to back. Running out
+// chains a block at least twice the size of the last; ArenaReset folds the
+// chain back into one block holding the total, so an arena reset every frame
+// stops touching the heap once it has seen its peak. Blocks come from
+// MemAlloc under the arena's tag.
+#define ARENA_MIN_BLOCK (64u << 10)
+#define ARENA_ALIGN     16
+
+struct ArenaBlock {
+    ArenaBlock* prev;
+    size_t size;  // data bytes
+    size_t used;
+};
+
+// Block data starts after the header, rounded up to ARENA_ALIGN
+#define ARENA_HEADER ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static unsigned char* arena_data(ArenaBlock* b) {
+    return (unsigned char*)b + ARENA_HEADER;
+}
+
+static ArenaBlock* arena_block_new(MemTag tag, size_t size, ArenaBlock* prev) {
+    if (size > SIZE_MAX - ARENA_HEADER) return NULL;
+    ArenaBlock* b = (ArenaBlock*)MemAlloc(tag, ARENA_HEADER + size);
+    if (!b) return NULL;
+    b->prev = prev;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+void* ArenaAlloc(Arena* a, size_t bytes, size_t align) {
+    if (align < ARENA_ALIGN) align = ARENA_ALIGN; // also rounds 0 and odd requests up
+    if (align & (align - 1)) {
+        fprintf(stderr, "ArenaAlloc: alignment %zu is not a power of two.\n", align);
+        return NULL;
+    }
+
+    ArenaBlock* b = a->block;
+    if (b) {
+        const uintptr_t base = (uintptr_t)arena_data(b);
+        const uintptr_t p = (base + b->used + align - 1) & ~(uintptr_t)(align - 1);
+        if (p - base <= b->size && bytes <= b->size - (p - base)) {
+            b->used = (size_t)(p - base) + bytes;
+            a->used += bytes;
+            return (void*)p;
+        }
+    }
+
+    // Chain a block big enough for this request at any alignment
+    size_t size = b ? b->size * 2 : ARENA_MIN_BLOCK;
+    if (bytes > SIZE_MAX / 2 - align) {
+        fprintf(stderr, "ArenaAlloc: %zu bytes is too large.\n", bytes);
+        return NULL;
+    }
+    while (size < bytes + align) size *= 2;
+    ArenaBlock* nb = arena_block_new(a->tag, size, b);
+    if (!nb) {
+        fprintf(stderr, "Out of memory growing arena to %zu bytes.\n", a->capacity + size);
+        return NULL;
+    }
+    a->block = nb;
+    a->capacity += size;
+    return ArenaAlloc(a, bytes, align);
+}
+
+void ArenaReset(Arena* a) {
+    a->used = 0;
+    ArenaBlock* b = a->block;
+    if (!b) return;
+    if (!b->prev) {
+        b->used = 0;
+        return;
+    }
+    const size_t total = a->capacity;
+    ArenaRelease(a);
+    a->block = arena_block_new(a->tag, total, NULL);
+    a->capacity = a->block ? total : 0; // on failure the next alloc starts over small
+}
+
+void ArenaRelease(Arena* a) {
+    ArenaBlock* b = a->block;
+    while (b) {
+        ArenaBlock* prev = b->prev;
+        MemFree(b);
+        b = prev;
+    }
+    *a = (Arena){ .tag = a->tag };
+}
+
+// Engine arenas
+// Two frame arenas alternate: AdvanceFrameArena (End2D) switches to the other
+// one and resets it, so an allocation lives through the frame it was made in
+// and the next one.
+static Arena s_frameArena[2] = { { .tag = MEM_FRAME }, { .tag = MEM_FRAME } };
+static int s_frameIndex = 0;
+static Arena s_persistentArena[MEM_TAG_COUNT]; // one per tag, tagged on first use
+
+void* FrameAlloc(size_t bytes) {
+    return ArenaAlloc(&s_frameArena[s_frameIndex], bytes, ARENA_ALIGN);
+}
+
+void AdvanceFrameArena(void) {
+    s_frameIndex ^= 1;
+    ArenaReset(&s_frameArena[s_frameIndex]);
+}
+
+void* PersistentAlloc(MemTag tag, size_t bytes) {
+    if ((unsigned)tag >= MEM_TAG_COUNT) tag = MEM_GENERAL;
+    Arena* a = &s_persistentArena[tag];
+    a->tag = tag;
+    return ArenaAlloc(a, bytes, ARENA_ALIGN);
+}
+
+void ReleaseEngineArenas(void) {
+    ArenaRelease(&s_frameArena[0]);
+    ArenaRelease(&s_frameArena[1]);
+    for (int i = 0; i < MEM_TAG_COUNT; ++i) ArenaRelease(&s_persistentArena[i]);
+}
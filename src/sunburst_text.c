@@ -0,0 +1,733 @@
+#include "sunburst.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Text
+// A small TrueType reader (cmap formats 4 and 12, hmtx, loca, glyf including
+// compound glyphs) feeding a signed-area coverage rasterizer. Glyphs are
+// rasterized on first draw per font, pixel size and codepoint into the shared
+// sprite texture array, so a line of text is a run of sprites and batches
+// with every other textured quad. Advances live in the same hashed cache and
+// never rasterize, which keeps Clay's per-word measuring cheap. Bitmaps are
+// capped at GLYPH_CACHE_BYTES: past it, or when the texture budget refuses an
+// upload, the least recently drawn ones are unloaded and redrawn on next use.
+// No hinting and no kerning; sizes are pixel heights (ascent - descent).
+
+#define FONT_MAX        16
+#define GLYPH_SIZE_MAX  512   // largest pixel size rasterized
+#define GLYPH_CACHE_BYTES (32u << 20) // glyph bitmaps kept in the texture array
+#define GLYPH_RETRY     1024  // DrawText calls before a refused upload is retried
+#define GLYPH_DEPTH_MAX 8     // compound glyph nesting
+#define GLYPH_FLATNESS  0.25f // curve flattening tolerance, pixels
+
+typedef struct FontFile {
+    unsigned char* data;
+    size_t size;
+    size_t loca, glyf, hmtx, cmap; // table offsets; cmap is the chosen subtable
+    int cmapFormat;                // 4 or 12
+    int numGlyphs, numHMetrics, unitsPerEm;
+    bool locaLong;
+    int ascent, descent, lineGap;  // font units
+} FontFile;
+
+// One (font, pixel size, codepoint). Blank glyphs keep tex.id 0.
+typedef struct GlyphEntry {
+    unsigned long long key;        // 0 = empty slot
+    unsigned int glyph;
+    float advance;                 // pixels
+    Texture tex;
+    short xoff, yoff;              // bitmap top-left from the pen and baseline
+    bool rasterized;
+    unsigned int lastUse;          // DrawText call that last drew it
+    unsigned int refusedAt;        // DrawText call whose upload was refused, 0 = none
+} GlyphEntry;
+
+typedef struct GlyphCache {
+    GlyphEntry* slots;
+    size_t cap;                    // power of two
+    size_t count;
+    size_t bytes;                  // bitmaps held, 4 bytes per texel
+    unsigned int tick;             // DrawText calls
+} GlyphCache;
+
+static FontFile   s_fonts[FONT_MAX];
+static GlyphCache s_glyphs;
+static bool       s_fontWarned[FONT_MAX];
+
+// Font file reading (big-endian, bounds checked against the file size)
+static inline unsigned int ttf_u16(const unsigned char* p) { return (unsigned int)p[0] << 8 | p[1]; }
+static inline int ttf_i16(const unsigned char* p) { return (short)ttf_u16(p); }
+static inline unsigned int ttf_u32(const unsigned char* p) {
+    return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3];
+}
+static inline float ttf_f2dot14(const unsigned char* p) { return ttf_i16(p) / 16384.0f; }
+
+static inline bool font_has(const FontFile* f, size_t off, size_t n) {
+    return off <= f->size && n <= f->size - off;
+}
+
+static size_t font_table(const FontFile* f, const char* tag, size_t minLen) {
+    if (!font_has(f, 0, 12)) return 0;
+    const unsigned int n = ttf_u16(f->data + 4);
+    for (unsigned int i = 0; i < n; ++i) {
+        const size_t rec = 12 + (size_t)16 * i;
+        if (!font_has(f, rec, 16)) return 0;
+        if (memcmp(f->data + rec, tag, 4) != 0) continue;
+        const size_t off = ttf_u32(f->data + rec + 8), len = ttf_u32(f->data + rec + 12);
+        return len >= minLen && font_has(f, off, len) ? off : 0;
+    }
+    return 0;
+}
+
+static bool font_parse(FontFile* f) {
+    const size_t head = font_table(f, "head", 54);
+    const size_t maxp = font_table(f, "maxp", 6);
+    const size_t hhea = font_table(f, "hhea", 36);
+    const size_t cmap = font_table(f, "cmap", 4);
+    f->loca = font_table(f, "loca", 0);
+    f->glyf = font_table(f, "glyf", 0);
+    f->hmtx = font_table(f, "hmtx", 4);
+    if (!head || !maxp || !hhea || !cmap || !f->loca || !f->glyf || !f->hmtx) return false;
+
+    const unsigned char* d = f->data;
+    f->unitsPerEm  = (int)ttf_u16(d + head + 18);
+    f->locaLong    = ttf_i16(d + head + 50) != 0;
+    f->numGlyphs   = (int)ttf_u16(d + maxp + 4);
+    f->ascent      = ttf_i16(d + hhea + 4);
+    f->descent     = ttf_i16(d + hhea + 6);
+    f->lineGap     = ttf_i16(d + hhea + 8);
+    f->numHMetrics = (int)ttf_u16(d + hhea + 34);
+    if (f->numHMetrics == 0 || f->ascent <= f->descent) return false;
+    if (!font_has(f, f->hmtx, (size_t)f->numHMetrics * 4)) return false;
+    if (!font_has(f, f->loca, (size_t)(f->numGlyphs + 1) * (f->locaLong ? 4 : 2))) return false;
+
+    // Prefer a full-Unicode format 12 subtable, then a BMP format 4 one
+    f->cmap = 0;
+    const unsigned int n = ttf_u16(d + cmap + 2);
+    for (unsigned int i = 0; i < n; ++i) {
+        const size_t rec = cmap + 4 + (size_t)8 * i;
+        if (!font_has(f, rec, 8)) break;
+        const unsigned int platform = ttf_u16(d + rec), encoding = ttf_u16(d + rec + 2);
+        if (!(platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10)))) continue;
+        const size_t sub = cmap + ttf_u32(d + rec + 4);
+        if (!font_has(f, sub, 16)) continue;
+        const int format = (int)ttf_u16(d + sub);
+        if (format == 12 || (format == 4 && f->cmapFormat != 12)) {
+            f->cmap = sub;
+            f->cmapFormat = format;
+        }
+    }
+    return f->cmap != 0;
+}
+
+static unsigned int font_glyph_index(const FontFile* f, unsigned int cp) {
+    const unsigned char* d = f->data;
+    if (f->cmapFormat == 12) {
+        const unsigned int groups = ttf_u32(d + f->cmap + 12);
+        if (!font_has(f, f->cmap + 16, (size_t)groups * 12)) return 0;
+        unsigned int lo = 0, hi = groups;
+        while (lo < hi) {
+            const unsigned int mid = (lo + hi) / 2;
+            const unsigned char* g = d + f->cmap + 16 + (size_t)12 * mid;
+            if (cp < ttf_u32(g))          hi = mid;
+            else if (cp > ttf_u32(g + 4)) lo = mid + 1;
+            else                          return ttf_u32(g + 8) + (cp - ttf_u32(g));
+        }
+        return 0;
+    }
+
+    if (cp > 0xFFFF) return 0;
+    const unsigned int segX2 = ttf_u16(d + f->cmap + 6);
+    const size_t ends = f->cmap + 14, starts = ends + segX2 + 2;
+    const size_t deltas = starts + segX2, ranges = deltas + segX2;
+    if (!font_has(f, ranges, segX2)) return 0;
+    for (unsigned int i = 0; i < segX2; i += 2) {
+        if (cp > ttf_u16(d + ends + i)) continue;
+        const unsigned int start = ttf_u16(d + starts + i);
+        if (cp < start) return 0;
+        const unsigned int delta = ttf_u16(d + deltas + i), ro = ttf_u16(d + ranges + i);
+        if (ro == 0) return (cp + delta) & 0xFFFF;
+        const size_t at = ranges + i + ro + (size_t)2 * (cp - start);
+        if (!font_has(f, at, 2)) return 0;
+        const unsigned int g = ttf_u16(d + at);
+        return g ? (g + delta) & 0xFFFF : 0;
+    }
+    return 0;
+}
+
+static int font_advance(const FontFile* f, unsigned int glyph) {
+    const unsigned int m = glyph < (unsigned int)f->numHMetrics ? glyph : (unsigned int)f->numHMetrics - 1;
+    return (int)ttf_u16(f->data + f->hmtx + (size_t)4 * m);
+}
+
+// Byte range of a glyph's outline; false for blank or invalid glyphs
+static bool font_glyph_data(const FontFile* f, unsigned int glyph, size_t* off, size_t* len) {
+    if (glyph >= (unsigned int)f->numGlyphs) return false;
+    const unsigned char* l = f->data + f->loca;
+    const size_t a = f->locaLong ? ttf_u32(l + 4 * glyph) : (size_t)2 * ttf_u16(l + 2 * glyph);
+    const size_t b = f->locaLong ? ttf_u32(l + 4 * glyph + 4) : (size_t)2 * ttf_u16(l + 2 * glyph + 2);
+    if (b <= a + 10 || !font_has(f, f->glyf + a, b - a)) return false;
+    *off = f->glyf + a;
+    *len = b - a;
+    return true;
+}
+
+static inline float font_scale(const FontFile* f, int pixelSize) {
+    return (float)pixelSize / (float)(f->ascent - f->descent);
+}
+
+// Coverage rasterizer
+// Each outline edge adds its signed area to the cells it crosses; a running
+// sum over the buffer then gives the coverage of every pixel.
+typedef struct GlyphRaster {
+    float* acc;                    // w * h + 1 cells
+    int w, h;
+    float scale, ox, oy;           // font units to bitmap: x * scale - ox, oy - y * scale
+    float a, b, c, d, e, f;        // current compound component transform
+    float penX, penY;              // outline walk state, bitmap pixels
+    float ctrlX, ctrlY;
+    bool hasCtrl;
+} GlyphRaster;
+
+static void raster_line(GlyphRaster* r, float x0, float y0, float x1, float y1) {
+    if (y0 == y1) return;
+    float dir = 1.0f;
+    if (y0 > y1) {
+        float t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+        dir = -1.0f;
+    }
+    const float dxdy = (x1 - x0) / (y1 - y0);
+    float x = x0;
+    if (y0 < 0.0f) x -= y0 * dxdy;
+    const int yEnd = (int)ceilf(y1) < r->h ? (int)ceilf(y1) : r->h;
+    for (int y = y0 > 0.0f ? (int)y0 : 0; y < yEnd; ++y) {
+        float* row = r->acc + (size_t)y * r->w;
+        const float dy = fminf((float)(y + 1), y1) - fmaxf((float)y, y0);
+        const float xNext = x + dxdy * dy;
+        const float d = dy * dir;
+        const float xa = fminf(x, xNext), xb = fmaxf(x, xNext);
+        const float xaFloor = floorf(xa);
+        const int xai = (int)xaFloor, xbi = (int)ceilf(xb);
+        if (xbi <= xai + 1) {
+            const float xm = 0.5f * (x + xNext) - xaFloor;
+            row[xai]     += d - d * xm;
+            row[xai + 1] += d * xm;
+        } else {
+            const float s = 1.0f / (xb - xa);
+            const float xaf = xa - xaFloor;
+            const float a0 = 0.5f * s * (1.0f - xaf) * (1.0f - xaf);
+            const float xbf = xb - ceilf(xb) + 1.0f;
+            const float am = 0.5f * s * xbf * xbf;
+            row[xai] += d * a0;
+            if (xbi == xai + 2) {
+                row[xai + 1] += d * (1.0f - a0 - am);
+            } else {
+                const float a1 = s * (1.5f - xaf);
+                row[xai + 1] += d * (a1 - a0);
+                for (int xi = xai + 2; xi < xbi - 1; ++xi) row[xi] += d * s;
+                const float a2 = a1 + (float)(xbi - xai - 3) * s;
+                row[xbi - 1] += d * (1.0f - a2 - am);
+            }
+            row[xbi] += d * am;
+        }
+        x = xNext;
+    }
+}
+
+// Font units through the component transform to clamped bitmap pixels
+static void raster_map(const GlyphRaster* r, float x, float y, float* px, float* py) {
+    const float fx = r->a * x + r->c * y + r->e, fy = r->b * x + r->d * y + r->f;
+    *px = fminf(fmaxf(fx * r->scale - r->ox, 0.0f), (float)(r->w - 1));
+    *py = fminf(fmaxf(r->oy - fy * r->scale, 0.0f), (float)r->h);
+}
+
+static void raster_quad(GlyphRaster* r, float x0, float y0, float cx, float cy, float x1, float y1) {
+    const float ex = x0 - 2.0f * cx + x1, ey = y0 - 2.0f * cy + y1;
+    const float dev = 0.25f * sqrtf(ex * ex + ey * ey);
+    int n = (int)ceilf(sqrtf(dev / GLYPH_FLATNESS));
+    if (n < 1) n = 1;
+    if (n > 32) n = 32;
+    float px = x0, py = y0;
+    for (int i = 1; i <= n; ++i) {
+        const float t = (float)i / (float)n, u = 1.0f - t;
+        const float qx = u * u * x0 + 2.0f * u * t * cx + t * t * x1;
+        const float qy = u * u * y0 + 2.0f * u * t * cy + t * t * y1;
+        raster_line(r, px, py, qx, qy);
+        px = qx; py = qy;
+    }
+}
+
+// Feeds one contour point, in bitmap pixels; implied on-curve midpoints
+// between consecutive off-curve points are inserted here.
+static void raster_point(GlyphRaster* r, float x, float y, bool on) {
+    if (on) {
+        if (r->hasCtrl) raster_quad(r, r->penX, r->penY, r->ctrlX, r->ctrlY, x, y);
+        else            raster_line(r, r->penX, r->penY, x, y);
+        r->penX = x; r->penY = y;
+        r->hasCtrl = false;
+    } else if (r->hasCtrl) {
+        const float mx = 0.5f * (r->ctrlX + x), my = 0.5f * (r->ctrlY + y);
+        raster_quad(r, r->penX, r->penY, r->ctrlX, r->ctrlY, mx, my);
+        r->penX = mx; r->penY = my;
+        r->ctrlX = x; r->ctrlY = y;
+    } else {
+        r->ctrlX = x; r->ctrlY = y;
+        r->hasCtrl = true;
+    }
+}
+
+static bool raster_glyph(GlyphRaster* r, const FontFile* f, unsigned int glyph, int depth);
+
+static bool raster_simple(GlyphRaster* r, const unsigned char* g, const unsigned char* end, int contours) {
+    if (g + 12 + 2 * contours > end) return false;
+    const int points = (int)ttf_u16(g + 10 + 2 * (contours - 1)) + 1;
+    const unsigned char* p = g + 12 + 2 * contours + ttf_u16(g + 10 + 2 * contours);
+
+    // x, y, then the flag bytes in one block
+    float* xs = (float*)FrameAlloc((size_t)points * (2 * sizeof(float) + 1));
+    if (!xs) {
+        fprintf(stderr, "Out of memory rasterizing glyph.\n");
+        return false;
+    }
+    float* ys = xs + points;
+    unsigned char* flags = (unsigned char*)(ys + points);
+    bool ok = true;
+
+    for (int i = 0; i < points && ok;) {
+        if (p >= end) { ok = false; break; }
+        const unsigned char fl = *p++;
+        int repeat = 0;
+        if (fl & 8) {
+            if (p >= end) { ok = false; break; }
+            repeat = *p++;
+        }
+        for (int k = 0; k <= repeat && i < points; ++k) flags[i++] = fl;
+    }
+
+    // Coordinates are deltas: a byte with its sign in the flags, a repeat
+    // of the previous value, or an int16.
+    for (int axis = 0; axis < 2 && ok; ++axis) {
+        const unsigned char isByte = axis ? 4 : 2, same = axis ? 32 : 16;
+        float* out = axis ? ys : xs;
+        float v = 0.0f;
+        for (int i = 0; i < points; ++i) {
+            if (flags[i] & isByte) {
+                if (p + 1 > end) { ok = false; break; }
+                v += (flags[i] & same) ? (float)*p : -(float)*p;
+                p += 1;
+            } else if (!(flags[i] & same)) {
+                if (p + 2 > end) { ok = false; break; }
+                v += (float)ttf_i16(p);
+                p += 2;
+            }
+            out[i] = v;
+        }
+    }
+
+    int s = 0;
+    for (int c = 0; c < contours && ok; ++c) {
+        const int e = (int)ttf_u16(g + 10 + 2 * c);
+        if (e < s || e >= points) { ok = false; break; }
+        const int n = e - s + 1;
+        float px, py, sx, sy;
+
+        // Start on the first on-curve point, or between the last and first
+        // points when the contour has none.
+        int first = -1;
+        for (int k = 0; k < n; ++k) if (flags[s + k] & 1) { first = k; break; }
+        if (first >= 0) {
+            raster_map(r, xs[s + first], ys[s + first], &sx, &sy);
+        } else {
+            raster_map(r, 0.5f * (xs[s] + xs[e]), 0.5f * (ys[s] + ys[e]), &sx, &sy);
+        }
+        r->penX = sx; r->penY = sy;
+        r->hasCtrl = false;
+        for (int k = first >= 0 ? 1 : 0; k < n; ++k) {
+            const int i = s + (first >= 0 ? (first + k) % n : k);
+            raster_map(r, xs[i], ys[i], &px, &py);
+            raster_point(r, px, py, flags[i] & 1);
+        }
+        raster_point(r, sx, sy, true);
+        s = e + 1;
+    }
+    return ok;
+}
+
+static bool raster_compound(GlyphRaster* r, const FontFile* f, const unsigned char* p,
+                            const unsigned char* end, int depth) {
+    const float pa = r->a, pb = r->b, pc = r->c, pd = r->d, pe = r->e, pf = r->f;
+    unsigned int flags;
+    do {
+        if (p + 4 > end) return false;
+        flags = ttf_u16(p);
+        const unsigned int child = ttf_u16(p + 2);
+        p += 4;
+
+        float dx = 0.0f, dy = 0.0f;
+        if (flags & 1) {
+            if (p + 4 > end) return false;
+            dx = (float)ttf_i16(p); dy = (float)ttf_i16(p + 2);
+            p += 4;
+        } else {
+            if (p + 2 > end) return false;
+            dx = (float)(signed char)p[0]; dy = (float)(signed char)p[1];
+            p += 2;
+        }
+        if (!(flags & 2)) dx = dy = 0.0f; // point-matched placement is not supported
+
+        float a = 1.0f, b = 0.0f, c = 0.0f, d = 1.0f;
+        if (flags & 8) {
+            if (p + 2 > end) return false;
+            a = d = ttf_f2dot14(p);
+            p += 2;
+        } else if (flags & 0x40) {
+            if (p + 4 > end) return false;
+            a = ttf_f2dot14(p); d = ttf_f2dot14(p + 2);
+            p += 4;
+        } else if (flags & 0x80) {
+            if (p + 8 > end) return false;
+            a = ttf_f2dot14(p); b = ttf_f2dot14(p + 2); c = ttf_f2dot14(p + 4); d = ttf_f2dot14(p + 6);
+            p += 8;
+        }
+
+        r->a = pa * a + pc * b;  r->b = pb * a + pd * b;
+        r->c = pa * c + pc * d;  r->d = pb * c + pd * d;
+        r->e = pa * dx + pc * dy + pe;
+        r->f = pb * dx + pd * dy + pf;
+        const bool ok = raster_glyph(r, f, child, depth + 1);
+        r->a = pa; r->b = pb; r->c = pc; r->d = pd; r->e = pe; r->f = pf;
+        if (!ok) return false;
+    } while (flags & 0x20);
+    return true;
+}
+
+static bool raster_glyph(GlyphRaster* r, const FontFile* f, unsigned int glyph, int depth) {
+    size_t off, len;
+    if (depth > GLYPH_DEPTH_MAX) return false;
+    if (!font_glyph_data(f, glyph, &off, &len)) return true; // blank component
+    const unsigned char* g = f->data + off;
+    const int contours = ttf_i16(g);
+    if (contours > 0) return raster_simple(r, g, g + len, contours);
+    if (contours < 0) return raster_compound(r, f, g + 10, g + len, depth);
+    return true;
+}
+
+// Glyph cache
+static inline unsigned long long glyph_key(int fontId, int size, unsigned int cp) {
+    return ((unsigned long long)(fontId + 1) << 48) | ((unsigned long long)size << 32) | cp;
+}
+
+static inline size_t glyph_slot(unsigned long long key, size_t cap) {
+    key ^= key >> 29;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 32;
+    return (size_t)key & (cap - 1);
+}
+
+// Rebuilds the table at newCap, leaving out entries whose key was cleared
+static bool glyph_cache_rehash(size_t newCap) {
+    GlyphEntry* slots = (GlyphEntry*)MemCalloc(MEM_TEXT, newCap, sizeof(GlyphEntry));
+    if (!slots) {
+        fprintf(stderr, "Out of memory growing glyph cache.\n");
+        return false;
+    }
+    for (size_t i = 0; i < s_glyphs.cap; ++i) {
+        const GlyphEntry* e = &s_glyphs.slots[i];
+        if (!e->key) continue;
+        size_t j = glyph_slot(e->key, newCap);
+        while (slots[j].key) j = (j + 1) & (newCap - 1);
+        slots[j] = *e;
+    }
+    MemFree(s_glyphs.slots);
+    s_glyphs.slots = slots;
+    s_glyphs.cap = newCap;
+    return true;
+}
+
+static void glyph_unload(GlyphEntry* e) {
+    if (!e->tex.id) return;
+    UnloadTexture(e->tex);
+    s_glyphs.bytes -= (size_t)e->tex.width * e->tex.height * 4;
+    e->tex = (Texture){0};
+}
+
+// Drops one font's entries and gives their bitmaps' space back
+static void glyph_cache_purge(int fontId) {
+    const unsigned long long tag = (unsigned long long)(fontId + 1);
+    size_t dropped = 0;
+    for (size_t i = 0; i < s_glyphs.cap; ++i) {
+        GlyphEntry* e = &s_glyphs.slots[i];
+        if (!e->key || e->key >> 48 != tag) continue;
+        glyph_unload(e);
+        e->key = 0;
+        dropped++;
+    }
+    if (!dropped) return;
+    s_glyphs.count -= dropped;
+    if (!glyph_cache_rehash(s_glyphs.cap)) { // probe chains are broken; start empty
+        for (size_t i = 0; i < s_glyphs.cap; ++i)
+            if (s_glyphs.slots[i].key) glyph_unload(&s_glyphs.slots[i]);
+        memset(s_glyphs.slots, 0, s_glyphs.cap * sizeof(GlyphEntry));
+        s_glyphs.count = 0;
+    }
+}
+
+// Cached cmap lookup and advance; the bitmap is made on first draw
+static GlyphEntry* glyph_lookup(const FontFile* f, int fontId, int size, unsigned int cp) {
+    const unsigned long long key = glyph_key(fontId, size, cp);
+    if (s_glyphs.cap) {
+        size_t i = glyph_slot(key, s_glyphs.cap);
+        for (; s_glyphs.slots[i].key; i = (i + 1) & (s_glyphs.cap - 1))
+            if (s_glyphs.slots[i].key == key) return &s_glyphs.slots[i];
+    }
+
+    if ((s_glyphs.count + 1) * 4 > s_glyphs.cap * 3 &&
+        !glyph_cache_rehash(s_glyphs.cap ? s_glyphs.cap * 2 : 1024)) return NULL;
+    size_t i = glyph_slot(key, s_glyphs.cap);
+    while (s_glyphs.slots[i].key) i = (i + 1) & (s_glyphs.cap - 1);
+
+    GlyphEntry* e = &s_glyphs.slots[i];
+    *e = (GlyphEntry){0};
+    e->key = key;
+    e->glyph = font_glyph_index(f, cp);
+    if (e->glyph >= (unsigned int)f->numGlyphs) e->glyph = 0; // corrupt cmap: .notdef
+    e->advance = (float)font_advance(f, e->glyph) * font_scale(f, size);
+    s_glyphs.count++;
+    return e;
+}
+
+static int glyph_use_cmp(const void* a, const void* b) {
+    const unsigned int ua = (*(GlyphEntry* const*)a)->lastUse, ub = (*(GlyphEntry* const*)b)->lastUse;
+    return ua < ub ? -1 : ua > ub;
+}
+
+// Unloads the least recently drawn bitmaps until at most `keep` bytes remain,
+// sparing the current DrawText call's. Evicted entries keep their advance
+// and rasterize again when next drawn.
+static void glyph_evict(size_t keep) {
+    GlyphEntry** order = (GlyphEntry**)FrameAlloc(s_glyphs.count * sizeof *order);
+    if (!order) return;
+    size_t n = 0;
+    for (size_t i = 0; i < s_glyphs.cap; ++i) {
+        GlyphEntry* e = &s_glyphs.slots[i];
+        if (e->key && e->tex.id && e->lastUse != s_glyphs.tick) order[n++] = e;
+    }
+    qsort(order, n, sizeof *order, glyph_use_cmp);
+    for (size_t i = 0; i < n && s_glyphs.bytes > keep; ++i) {
+        glyph_unload(order[i]);
+        order[i]->rasterized = false;
+    }
+}
+
+static void glyph_rasterize(const FontFile* f, int size, GlyphEntry* e) {
+    if (e->refusedAt && s_glyphs.tick - e->refusedAt < GLYPH_RETRY) return;
+    e->rasterized = true;
+    size_t off, len;
+    if (!font_glyph_data(f, e->glyph, &off, &len)) return; // blank, e.g. space
+
+    const unsigned char* g = f->data + off;
+    const float scale = font_scale(f, size);
+    const int x0 = (int)floorf((float)ttf_i16(g + 2) * scale), x1 = (int)ceilf((float)ttf_i16(g + 6) * scale);
+    const int y0 = (int)floorf(-(float)ttf_i16(g + 8) * scale), y1 = (int)ceilf(-(float)ttf_i16(g + 4) * scale);
+    const int w = x1 - x0 + 1, h = y1 - y0; // one spare column for the last cell's spill
+    if (w <= 1 || h <= 0) return;
+    if (w > 4 * size + 8 || h > 4 * size + 8) { // corrupt bounding box
+        fprintf(stderr, "Malformed outline for glyph %u.\n", e->glyph);
+        return;
+    }
+
+    GlyphRaster r = { 0 };
+    r.w = w; r.h = h;
+    r.scale = scale;
+    r.ox = (float)x0;
+    r.oy = (float)-y0;
+    r.a = r.d = 1.0f;
+    // Scratch from the frame arena; glyphs rasterize mid-frame on cache misses
+    r.acc = (float*)FrameAlloc(((size_t)w * h + 1) * sizeof(float));
+    unsigned char* rgba = (unsigned char*)FrameAlloc((size_t)w * h * 4);
+    if (!r.acc || !rgba) {
+        fprintf(stderr, "Out of memory rasterizing glyph.\n");
+        return;
+    }
+    memset(r.acc, 0, ((size_t)w * h + 1) * sizeof(float));
+
+    if (raster_glyph(&r, f, e->glyph, 0)) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < (size_t)w * h; ++i) {
+            sum += r.acc[i];
+            const float cover = fminf(fabsf(sum), 1.0f);
+            rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 255;
+            rgba[i * 4 + 3] = (unsigned char)(cover * 255.0f + 0.5f);
+        }
+        const size_t bytes = (size_t)w * h * 4;
+        if (s_glyphs.bytes + bytes > GLYPH_CACHE_BYTES) glyph_evict(GLYPH_CACHE_BYTES * 3 / 4);
+        e->tex = LoadTextureFromPixels(rgba, w, h);
+        if (!e->tex.id && !e->refusedAt) { // over the texture budget: make room once
+            glyph_evict(s_glyphs.bytes / 2);
+            e->tex = LoadTextureFromPixels(rgba, w, h);
+        }
+        if (e->tex.id) {
+            s_glyphs.bytes += bytes;
+            e->refusedAt = 0;
+        } else { // drawn blank, tried again GLYPH_RETRY calls later
+            e->rasterized = false;
+            e->refusedAt = s_glyphs.tick ? s_glyphs.tick : 1;
+        }
+        e->xoff = (short)x0;
+        e->yoff = (short)y0;
+    } else {
+        fprintf(stderr, "Malformed outline for glyph %u.\n", e->glyph);
+    }
+}
+
+// Decodes one UTF-8 sequence; malformed bytes come back as U+FFFD
+static unsigned int utf8_next(const unsigned char* s, int n, int* i) {
+    const unsigned int c = s[(*i)++];
+    if (c < 0x80) return c;
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : -1;
+    if (extra < 0 || *i + extra > n) return 0xFFFD;
+    unsigned int cp = c & (0x3F >> extra);
+    while (extra--) {
+        const unsigned int b = s[*i];
+        if ((b & 0xC0) != 0x80) return 0xFFFD;
+        cp = cp << 6 | (b & 0x3F);
+        (*i)++;
+    }
+    return cp;
+}
+
+static const FontFile* font_get(int fontId) {
+    if (fontId < 0 || fontId >= FONT_MAX) return NULL;
+    const FontFile* f = &s_fonts[fontId];
+    if (f->data) return f;
+    if (!s_fontWarned[fontId]) {
+        fprintf(stderr, "Font %d is not loaded.\n", fontId);
+        s_fontWarned[fontId] = true;
+    }
+    return NULL;
+}
+
+static inline int clamp_size(int size) {
+    return size < 1 ? 1 : (size > GLYPH_SIZE_MAX ? GLYPH_SIZE_MAX : size);
+}
+
+// Public API
+
+bool LoadFontFromMemory(int fontId, const unsigned char* ttf, size_t size) {
+    if (fontId < 0 || fontId >= FONT_MAX || !ttf) {
+        fprintf(stderr, "Font id %d is out of range (0..%d).\n", fontId, FONT_MAX - 1);
+        return false;
+    }
+    FontFile f = { 0 };
+    f.data = (unsigned char*)MemAlloc(MEM_TEXT, size);
+    if (!f.data) {
+        fprintf(stderr, "Out of memory loading font.\n");
+        return false;
+    }
+    memcpy(f.data, ttf, size);
+    f.size = size;
+    if (!font_parse(&f)) {
+        fprintf(stderr, "Font %d is not a TrueType font with glyf outlines.\n", fontId);
+        MemFree(f.data);
+        return false;
+    }
+
+    // Cached entries of a replaced font are stale, along with their bitmaps
+    if (s_fonts[fontId].data) {
+        MemFree(s_fonts[fontId].data);
+        glyph_cache_purge(fontId);
+    }
+    s_fonts[fontId] = f;
+    s_fontWarned[fontId] = false;
+    return true;
+}
+
+bool LoadFont(int fontId, const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open font %s.\n", path);
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char* data = size > 0 ? (unsigned char*)MemAlloc(MEM_TEXT, (size_t)size) : NULL;
+    const bool read = data && fread(data, 1, (size_t)size, fp) == (size_t)size;
+    fclose(fp);
+    if (!read) {
+        fprintf(stderr, "Failed to read font %s.\n", path);
+        MemFree(data);
+        return false;
+    }
+    const bool ok = LoadFontFromMemory(fontId, data, (size_t)size);
+    MemFree(data);
+    return ok;
+}
+
+void UnloadFonts(void) {
+    for (size_t i = 0; i < s_glyphs.cap; ++i)
+        if (s_glyphs.slots[i].key) glyph_unload(&s_glyphs.slots[i]);
+    for (int i = 0; i < FONT_MAX; ++i) MemFree(s_fonts[i].data);
+    memset(s_fonts, 0, sizeof s_fonts);
+    memset(s_fontWarned, 0, sizeof s_fontWarned);
+    MemFree(s_glyphs.slots);
+    s_glyphs = (GlyphCache){0};
+}
+
+TextSize MeasureText(int fontId, const char* text, int length, int fontSize, int letterSpacing) {
+    TextSize out = { 0.0f, 0.0f };
+    const FontFile* f = font_get(fontId);
+    if (!f || !text) return out;
+    const int size = clamp_size(fontSize);
+    const int n = length < 0 ? (int)strlen(text) : length;
+    const float lineAdvance = (float)(f->ascent - f->descent + f->lineGap) * font_scale(f, size);
+
+    float line = 0.0f;
+    int glyphs = 0, lines = 1;
+    for (int i = 0; i < n;) {
+        const unsigned int cp = utf8_next((const unsigned char*)text, n, &i);
+        if (cp == '\n') {
+            if (line > out.width) out.width = line;
+            line = 0.0f;
+            glyphs = 0;
+            lines++;
+            continue;
+        }
+        const GlyphEntry* e = glyph_lookup(f, fontId, size, cp);
+        if (!e) break;
+        line += e->advance + (glyphs++ ? (float)letterSpacing : 0.0f);
+    }
+    if (line > out.width) out.width = line;
+    out.height = (float)size + (float)(lines - 1) * lineAdvance;
+    return out;
+}
+
+void DrawText(int fontId, const char* text, int length, int x, int y, int fontSize, int letterSpacing, Color color) {
+    const FontFile* f = font_get(fontId);
+    if (!f || !text) return;
+    const int size = clamp_size(fontSize);
+    const int n = length < 0 ? (int)strlen(text) : length;
+    const float scale = font_scale(f, size);
+    const float lineAdvance = (float)(f->ascent - f->descent + f->lineGap) * scale;
+
+    float penX = (float)x, baseline = (float)y + roundf((float)f->ascent * scale);
+    s_glyphs.tick++;
+    for (int i = 0; i < n;) {
+        const unsigned int cp = utf8_next((const unsigned char*)text, n, &i);
+        if (cp == '\n') {
+            penX = (float)x;
+            baseline += roundf(lineAdvance);
+            continue;
+        }
+        GlyphEntry* e = glyph_lookup(f, fontId, size, cp);
+        if (!e) break;
+        e->lastUse = s_glyphs.tick;
+        if (!e->rasterized) glyph_rasterize(f, size, e);
+        if (e->tex.id) DrawTexture(e->tex, (int)roundf(penX) + e->xoff, (int)baseline + e->yoff, color);
+        penX += e->advance + (float)letterSpacing;
+    }
+}
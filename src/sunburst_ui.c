@@ -1,2 +1,341 @@
 #include "sunburst.h"
 
+#include <math.h>
+#include <stdio.h>
+
+static Color clay_color(Clay_Color c) {
+    return (Color){ c.r / 255.0f, c.g / 255.0f, c.b / 255.0f, c.a / 255.0f };
+}
+
+static CornerRadii clay_radii(Clay_CornerRadius r) {
+    return (CornerRadii){ r.topLeft, r.topRight, r.bottomLeft, r.bottomRight };
+}
+
+// Draws one command shifted by -dx, -dy
+static void draw_command(const Clay_RenderCommand* rc, float dx, float dy) {
+    Clay_BoundingBox bb = rc->boundingBox;
+    bb.x -= dx;
+    bb.y -= dy;
+    switch (rc->commandType) {
+        case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
+            const Clay_RectangleRenderData* r = &rc->renderData.rectangle;
+            DrawRectangleRounded(bb.x, bb.y, bb.width, bb.height,
+                                 clay_radii(r->cornerRadius), clay_color(r->backgroundColor));
+        } break;
+        case CLAY_RENDER_COMMAND_TYPE_BORDER: {
+            const Clay_BorderRenderData* b = &rc->renderData.border;
+            BorderWidths widths = { b->width.left, b->width.right, b->width.top, b->width.bottom };
+            DrawRectangleBorder(bb.x, bb.y, bb.width, bb.height, widths,
+                                clay_radii(b->cornerRadius), clay_color(b->color));
+        } break;
+        case CLAY_RENDER_COMMAND_TYPE_IMAGE: {
+            const Texture* tex = (const Texture*)rc->renderData.image.imageData;
+            Clay_Color tint = rc->renderData.image.backgroundColor;
+            // Clay's default tint is 0,0,0,0, meaning untinted
+            if (tint.r == 0 && tint.g == 0 && tint.b == 0 && tint.a == 0)
+                tint = (Clay_Color){ 255, 255, 255, 255 };
+            if (tex) DrawTextureRect(*tex, bb.x, bb.y, bb.width, bb.height, clay_color(tint));
+        } break;
+        case CLAY_RENDER_COMMAND_TYPE_TEXT: {
+            const Clay_TextRenderData* t = &rc->renderData.text;
+            // The box is the line height; center the font's own height in it
+            DrawText(t->fontId, t->stringContents.chars, t->stringContents.length,
+                     bb.x, bb.y + (bb.height - t->fontSize) / 2, t->fontSize, t->letterSpacing,
+                     clay_color(t->textColor));
+        } break;
+        case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START: {
+            BeginScissor(bb.x, bb.y, bb.width, bb.height);
+        } break;
+        case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END: {
+            EndScissor();
+        } break;
+        default:
+            break;
+    }
+}
+
+Clay_Dimensions MeasureClayText(Clay_StringSlice text, Clay_TextElementConfig* config, void* userData) {
+    (void)userData;
+    const TextSize size = MeasureText(config->fontId, text.chars, text.length, config->fontSize, config->letterSpacing);
+    return (Clay_Dimensions){ size.width, size.height };
+}
+
+// Retained frame: a 64-bit FNV-1a hash of everything that affects the pixels
+static unsigned long long s_frameHash = 0;
+static bool s_frameValid = false;
+
+static unsigned long long hash_bytes(unsigned long long h, const void* data, size_t n) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 0x100000001b3ull; }
+    return h;
+}
+
+#define HASH_FIELD(h, f) hash_bytes((h), &(f), sizeof(f))
+
+static unsigned long long hash_command(unsigned long long h, const Clay_RenderCommand* rc) {
+    const Clay_RenderData* d = &rc->renderData;
+    h = HASH_FIELD(h, rc->commandType);
+    h = HASH_FIELD(h, rc->boundingBox);
+    h = HASH_FIELD(h, rc->zIndex);
+    switch (rc->commandType) {
+        case CLAY_RENDER_COMMAND_TYPE_RECTANGLE:
+            h = HASH_FIELD(h, d->rectangle.backgroundColor);
+            h = HASH_FIELD(h, d->rectangle.cornerRadius);
+            break;
+        case CLAY_RENDER_COMMAND_TYPE_BORDER:
+            h = HASH_FIELD(h, d->border.color);
+            h = HASH_FIELD(h, d->border.cornerRadius);
+            h = HASH_FIELD(h, d->border.width);
+            break;
+        case CLAY_RENDER_COMMAND_TYPE_IMAGE:
+            h = HASH_FIELD(h, d->image.backgroundColor);
+            h = HASH_FIELD(h, d->image.cornerRadius);
+            if (d->image.imageData) h = hash_bytes(h, d->image.imageData, sizeof(Texture));
+            break;
+        case CLAY_RENDER_COMMAND_TYPE_TEXT:
+            h = hash_bytes(h, d->text.stringContents.chars, (size_t)d->text.stringContents.length);
+            h = HASH_FIELD(h, d->text.textColor);
+            h = HASH_FIELD(h, d->text.fontId);
+            h = HASH_FIELD(h, d->text.fontSize);
+            h = HASH_FIELD(h, d->text.letterSpacing);
+            h = HASH_FIELD(h, d->text.lineHeight);
+            break;
+        case CLAY_RENDER_COMMAND_TYPE_CUSTOM:
+            h = HASH_FIELD(h, d->custom.backgroundColor);
+            h = HASH_FIELD(h, d->custom.cornerRadius);
+            h = HASH_FIELD(h, d->custom.customData);
+            break;
+        default: // scissor start/end: the bounding box is the whole command
+            break;
+    }
+    return h;
+}
+
+bool ClayFrameChanged(Clay_RenderCommandArray cmds, int fbWidth, int fbHeight) {
+    unsigned long long h = 0xcbf29ce484222325ull;
+    h = HASH_FIELD(h, fbWidth);
+    h = HASH_FIELD(h, fbHeight);
+    for (int i = 0; i < cmds.length; i++) h = hash_command(h, &cmds.internalArray[i]);
+
+    if (s_frameValid && h == s_frameHash) return false;
+    s_frameHash = h;
+    s_frameValid = true;
+    return true;
+}
+
+void InvalidateClayFrame(void) {
+    s_frameValid = false;
+}
+
+// Cached elements
+// A cached element's subtree is the run of commands that starts with the
+// first one inside the element's box and continues while they stay inside it
+// (scissor pairs kept whole). Its hash is taken relative to the box, and once
+// it has held for CLAY_CACHE_STABLE frames the run is drawn into a render
+// texture and composited as one quad until the hash changes.
+#define CLAY_CACHE_MAX    32
+#define CLAY_CACHE_STABLE 2     // unchanged frames before rendering to a texture
+#define CLAY_CACHE_SIZE   2046  // largest texture the renderer packs
+
+typedef struct ClayCache {
+    Clay_ElementId id;
+    Clay_BoundingBox box;       // this frame's element box
+    bool present;               // element laid out this frame
+    bool handled;               // run already drawn this frame
+    int runStart, runLen;       // where that run was
+    unsigned long long hash;
+    int stable;                 // consecutive frames with this hash
+    Texture tex;
+    bool valid;                 // tex holds the run for hash
+    RenderBackend backend;      // backend tex was drawn with
+} ClayCache;
+
+static ClayCache s_cache[CLAY_CACHE_MAX];
+static int s_cacheCount = 0;
+
+static inline bool box_inside(Clay_BoundingBox b, Clay_BoundingBox box) {
+    return b.width > 0 && b.height > 0 && b.x >= box.x && b.y >= box.y &&
+           b.x + b.width <= box.x + box.width && b.y + b.height <= box.y + box.height;
+}
+
+// Length of the run starting at cmds[start], or 0 if its scissors don't pair up
+static int cache_run(Clay_RenderCommandArray cmds, int start, Clay_BoundingBox box) {
+    int depth = 0, i = start;
+    for (; i < cmds.length; ++i) {
+        const Clay_RenderCommand* rc = &cmds.internalArray[i];
+        if (rc->commandType == CLAY_RENDER_COMMAND_TYPE_SCISSOR_END) {
+            if (depth == 0) break;
+            depth--;
+            continue;
+        }
+        if (!box_inside(rc->boundingBox, box)) break;
+        if (rc->commandType == CLAY_RENDER_COMMAND_TYPE_SCISSOR_START) depth++;
+    }
+    return depth == 0 ? i - start : 0;
+}
+
+// Draws the cached element's run starting at cmds[start]; returns its length.
+static int draw_cached(Clay_RenderCommandArray cmds, int start, ClayCache* c) {
+    c->handled = true;
+    const int n = cache_run(cmds, start, c->box);
+    c->runStart = start;
+    c->runLen = n;
+    if (n == 0) {
+        c->stable = 0;
+        c->valid = false;
+        return 0;
+    }
+
+    // Whole-pixel origin, so each command lands on the same pixels as it
+    // would drawn in place
+    const float ox = floorf(c->box.x), oy = floorf(c->box.y);
+    const int w = (int)ceilf(c->box.x + c->box.width) - (int)ox;
+    const int h = (int)ceilf(c->box.y + c->box.height) - (int)oy;
+
+    unsigned long long hash = 0xcbf29ce484222325ull;
+    hash = HASH_FIELD(hash, w);
+    hash = HASH_FIELD(hash, h);
+    for (int i = start; i < start + n; ++i) {
+        Clay_RenderCommand rel = cmds.internalArray[i];
+        if (rel.commandType != CLAY_RENDER_COMMAND_TYPE_SCISSOR_END) { // has no box
+            rel.boundingBox.x -= ox;
+            rel.boundingBox.y -= oy;
+        }
+        hash = hash_command(hash, &rel);
+    }
+    if (hash != c->hash || c->backend != GetRenderBackend()) {
+        c->hash = hash;
+        c->stable = 0;
+        c->valid = false;
+        c->backend = GetRenderBackend();
+    }
+    if (c->stable < CLAY_CACHE_STABLE) c->stable++;
+
+    if (!c->valid && c->stable >= CLAY_CACHE_STABLE && w <= CLAY_CACHE_SIZE && h <= CLAY_CACHE_SIZE) {
+        if (!c->tex.id) c->tex = LoadRenderTexture(w, h);
+        else if (!ResizeRenderTexture(&c->tex, w, h)) {
+            UnloadTexture(c->tex);
+            c->tex.id = 0;
+        }
+        if (c->tex.id) {
+            BeginTextureMode(c->tex);
+            for (int i = start; i < start + n; ++i) draw_command(&cmds.internalArray[i], ox, oy);
+            EndTextureMode();
+            c->valid = true;
+        }
+    }
+
+    if (c->valid) {
+        DrawTexture(c->tex, (int)ox, (int)oy, (Color){ 1.0f, 1.0f, 1.0f, 1.0f });
+    } else {
+        for (int i = start; i < start + n; ++i) draw_command(&cmds.internalArray[i], 0, 0);
+    }
+    return n;
+}
+
+void SetClayElementCached(Clay_ElementId id, bool cached) {
+    for (int i = 0; i < s_cacheCount; ++i) {
+        if (s_cache[i].id.id != id.id) continue;
+        if (!cached) {
+            UnloadTexture(s_cache[i].tex);
+            s_cache[i] = s_cache[--s_cacheCount];
+        }
+        return;
+    }
+    if (!cached) return;
+    if (s_cacheCount == CLAY_CACHE_MAX) {
+        fprintf(stderr, "Too many cached Clay elements (%d).\n", CLAY_CACHE_MAX);
+        return;
+    }
+    s_cache[s_cacheCount++] = (ClayCache){ .id = id };
+}
+
+// Keeps each texture to redraw into once the element is stable again
+void InvalidateClayCache(void) {
+    for (int i = 0; i < s_cacheCount; ++i)
+        s_cache[i] = (ClayCache){ .id = s_cache[i].id, .tex = s_cache[i].tex };
+}
+
+void ReleaseClayCache(void) {
+    for (int i = 0; i < s_cacheCount; ++i) {
+        UnloadTexture(s_cache[i].tex);
+        s_cache[i] = (ClayCache){ .id = s_cache[i].id };
+    }
+}
+
+static bool s_textNative = false;
+
+void SetClayTextNative(bool native) {
+    s_textNative = native;
+}
+
+// The cached element whose run starts at cmds[i] this frame, if any
+static ClayCache* cached_run_at(int i) {
+    for (int k = 0; k < s_cacheCount; ++k)
+        if (s_cache[k].handled && s_cache[k].runLen && s_cache[k].runStart == i) return &s_cache[k];
+    return NULL;
+}
+
+static void draw_clay_commands(Clay_RenderCommandArray cmds) {
+    bool anyCached = false;
+    for (int k = 0; k < s_cacheCount; ++k) {
+        ClayCache* c = &s_cache[k];
+        const Clay_ElementData d = Clay_GetElementData(c->id);
+        c->present = d.found && d.boundingBox.width > 0 && d.boundingBox.height > 0;
+        c->box = d.boundingBox;
+        c->handled = false;
+        anyCached |= c->present;
+    }
+    // A capture would record the composite as an unrecorded sprite, so cached
+    // runs draw in place while one is running
+    if (IsCapturing()) anyCached = false;
+
+    // Native text defers text and cached runs (crisp already in their
+    // texture) to a second pass at full resolution.
+    const bool native = s_textNative && GetResolutionScale() < 1.0f;
+    for (int i = 0; i < cmds.length; i++) {
+        const Clay_RenderCommand* rc = &cmds.internalArray[i];
+        if (anyCached) {
+            int n = 0;
+            for (int k = 0; k < s_cacheCount && !n; ++k) {
+                ClayCache* c = &s_cache[k];
+                if (!c->present || c->handled || !box_inside(rc->boundingBox, c->box)) continue;
+                if (native) {
+                    c->handled = true;
+                    c->runStart = i;
+                    c->runLen = n = cache_run(cmds, i, c->box);
+                } else {
+                    n = draw_cached(cmds, i, c);
+                }
+            }
+            if (n) {
+                i += n - 1;
+                continue;
+            }
+        }
+        if (native && rc->commandType == CLAY_RENDER_COMMAND_TYPE_TEXT) continue;
+        draw_command(rc, 0, 0);
+    }
+    if (!native) return;
+
+    // Second pass: text and cached runs, under the same scissors
+    BeginNativeResolution();
+    for (int i = 0; i < cmds.length; i++) {
+        ClayCache* c = anyCached ? cached_run_at(i) : NULL;
+        if (c) {
+            i += draw_cached(cmds, i, c) - 1;
+            continue;
+        }
+        const Clay_RenderCommand* rc = &cmds.internalArray[i];
+        if (rc->commandType == CLAY_RENDER_COMMAND_TYPE_TEXT ||
+            rc->commandType == CLAY_RENDER_COMMAND_TYPE_SCISSOR_START ||
+            rc->commandType == CLAY_RENDER_COMMAND_TYPE_SCISSOR_END)
+            draw_command(rc, 0, 0);
+    }
+}
+
+void DrawClayCommands(Clay_RenderCommandArray cmds) {
+    PROFILE_BEGIN("DrawClayCommands");
+    draw_clay_commands(cmds);
+    PROFILE_END();
+}
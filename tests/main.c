@@ -46,8 +46,7 @@ static Clay_ElementDeclaration sidebarItemConfig = (Clay_ElementDeclaration){
     .backgroundColor = COLOR_ORANGE
 };
 
-typedef struct { int placeholder; } MyImageHandle;
-static MyImageHandle profilePicture = {0};
+static Texture profilePicture = {0};
 
 static void SidebarItemComponent(void) {
     // Use a real Clay element id:
@@ -56,7 +55,7 @@ static void SidebarItemComponent(void) {
     }
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
     glfwSetErrorCallback(error_callback);
 
@@ -79,13 +78,19 @@ int main(void)
     glfwMakeContextCurrent(window);
     //gladLoadGL(glfwGetProcAddress);
     glfwSwapInterval(1);
+    const GLFWvidmode* vidmode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (vidmode && vidmode->refreshRate > 0) SetFrameDeadline(1000.0 / vidmode->refreshRate);
 
     RendererInit();
+    SetOpaqueDepthPass(true); // nested opaque Clay backgrounds
 
     uint64_t bytes = Clay_MinMemorySize();
-    void* mem = malloc(bytes);
+    void* mem = PersistentAlloc(MEM_UI, bytes); // lives as long as the engine
     Clay_Arena arena = Clay_CreateArenaWithCapacityAndMemory(bytes, mem);
     Clay_Initialize(arena, (Clay_Dimensions){ 640, 480 }, (Clay_ErrorHandler){ HandleClayErrors });
+    Clay_SetMeasureTextFunction(MeasureClayText, NULL);
+    if (argc > 1) LoadFont(0, argv[1]); // a .ttf for fontId 0
+    SetClayElementCached(CLAY_ID("SideBar"), true); // static, so composited from a texture
 
    
 while (!glfwWindowShouldClose(window))
@@ -144,6 +149,7 @@ while (!glfwWindowShouldClose(window))
                             .image  = { .imageData = &profilePicture }
                         }
                     ) { }
+                    CLAY_TEXT(CLAY_STRING("Sunburst"), CLAY_TEXT_CONFIG({ .fontSize = 24, .textColor = COLOR_LIGHT }));
                 }
 
                 for (int i = 0; i < 1; i++) {
@@ -164,27 +170,12 @@ while (!glfwWindowShouldClose(window))
         ClearBackground();
         Begin2D(fbW, fbH);
 
-        for (int i = 0; i < cmds.length; i++) {
-            Clay_RenderCommand* rc = &cmds.internalArray[i];
-            switch (rc->commandType) {
-                case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
-                    Color c = {
-                        rc->renderData.rectangle.backgroundColor.r / 255.0f,
-                        rc->renderData.rectangle.backgroundColor.g / 255.0f,
-                        rc->renderData.rectangle.backgroundColor.b / 255.0f,
-                        rc->renderData.rectangle.backgroundColor.a / 255.0f
-                    };
-                    DrawRectangle(rc->boundingBox.x, rc->boundingBox.y,
-                                  rc->boundingBox.width, rc->boundingBox.height, c);
-                } break;
-                default:
-                    break;
-            }
-        }
+        DrawClayCommands(cmds);
 
         End2D();
 
     glfwSwapBuffers(window);
+    PrintFrameRate(); // percentiles and missed vsyncs, once a second
     glfwPollEvents();
 }
 